@@ -0,0 +1,205 @@
+#include "lottery.h"
+
+#include <sys/resource.h>
+#include <sys/wait.h>
+
+// Times edition construction, sale, the draw per ball, a full play and a prize search
+// for editions of 10^k tickets under each container policy. Output lines are "stage
+// policy tickets ns/unit units/s peak_rss_kb" and carry no timestamps, so runs of two
+// builds can be diffed. The unit is a ticket, except for search, which is timed per
+// result it returns.
+//
+// Each (size, policy) runs two forked children: one for a standalone edition
+// (construct, sell, draw/ball) and one for a game (play, search). peak_rss_kb is the
+// high-water mark of the stage's child when the stage ends, so it is cumulative: it
+// includes the stages before it in the same child, whose data the stage runs on.
+
+using Clock = std::chrono::steady_clock;
+
+size_t peak_rss_kb() {
+  rusage usage;
+  getrusage(RUSAGE_SELF, &usage);
+
+  return usage.ru_maxrss;
+}
+
+const char* kPolicies[] = {"queue", "vector", "reserved", "chunked"};
+
+// Prints one stage that took `seconds` for `work` units
+void report(const char* stage, const char* policy, size_t tickets, double seconds, double work) {
+  double ns = seconds * 1e9 / std::max(work, 1.0);
+
+  printf("%-10s %-9s %12zu %12.2f %14.0f %12zu\n", stage, policy, tickets, ns, ns > 0 ? 1e9 / ns : 0, peak_rss_kb());
+  fflush(stdout);
+}
+
+double elapsed(Clock::time_point start) {
+  return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+// Stage groups, each run in a child of its own
+const char* kGroups[] = {"edition", "game"};
+
+template <template <typename...> typename T>
+void bench_size(size_t group, const char* policy, size_t tickets, double percentage, DrawEngine engine) {
+  size_t sold = std::max<size_t>(percentage * tickets / 100, 1);
+  size_t fund = Game<T>::kPercentagePrizeFund * Ticket<Lotto90>::price * sold;
+
+  if (!group) {
+    auto start = Clock::now();
+    Edition<T> edition(0, tickets, 0, 0, rnd_gen(), RNG);
+    report("construct", policy, tickets, elapsed(start), tickets);
+
+    start = Clock::now();
+    edition.sell(sold, engine);
+    report("sell", policy, tickets, elapsed(start), sold);
+
+    edition.set_fund(fund);
+
+    unsigned char balls[Lotto90::max_num];
+    size_t prize_fund = fund;
+
+    for (size_t i = 0; i < Lotto90::max_num; ++i)
+      balls[i] = i + 1;
+
+    shuffle<unsigned char>(balls, Lotto90::max_num);
+
+    // One play under Game::play's rules, without its output
+    start = Clock::now();
+    size_t scans = edition.play(balls, prize_fund, [](size_t) {}, [](size_t, Round*) {});
+    report("draw/ball", policy, tickets, elapsed(start), static_cast<double>(scans) * sold);
+    return;
+  }
+
+  std::ostream null(nullptr);
+  Game<T> game(null);
+
+  game.set_engine(engine);
+  game.add(tickets, 0, false, false, false);
+  game.sell(percentage);
+
+  auto start = Clock::now();
+  game.play();
+  report("play", policy, tickets, elapsed(start), sold);
+
+  typename Game<T>::SearchResults list;
+
+  start = Clock::now();
+  game.find_prizes(0, 1, 0, SIZE_MAX, list);
+  list.sort([](const std::pair<size_t, size_t>& a, const std::pair<size_t, size_t>& b) { return (a.second > b.second) || (a.second == b.second && a.first < b.first); });
+  report("search", policy, tickets, elapsed(start), list.size());
+}
+
+void bench_policy(size_t group, size_t policy, size_t tickets, double percentage, DrawEngine engine) {
+  if (policy == 0)
+    bench_size<std::queue>(group, kPolicies[policy], tickets, percentage, engine);
+  else if (policy == 1)
+    bench_size<VectorPolicy>(group, kPolicies[policy], tickets, percentage, engine);
+  else if (policy == 2)
+    bench_size<ReservedPolicy>(group, kPolicies[policy], tickets, percentage, engine);
+  else
+    bench_size<ChunkedPolicy>(group, kPolicies[policy], tickets, percentage, engine);
+}
+
+int main(int argc, char** argv) {
+  size_t min_tickets = 10000;
+  size_t max_tickets = 100000000;
+  double percentage = 100;
+  // Of the sell and draw paths, policies only hold the index engine's postings; the
+  // other engines sell and draw with the same code under every policy
+  std::string engine = "index";
+  std::string policy = "all";
+  uint64_t seed = 1;
+
+  for (int i = 1; i < argc; ++i) {
+    std::string arg = argv[i];
+
+    if (arg == "--min" && i + 1 < argc)
+      min_tickets = std::max<size_t>(std::strtoul(argv[++i], nullptr, 10), 1);
+    else if (arg == "--max" && i + 1 < argc)
+      max_tickets = std::strtoul(argv[++i], nullptr, 10);
+    else if (arg == "--sell" && i + 1 < argc)
+      percentage = std::strtod(argv[++i], nullptr);
+    else if (arg == "--engine" && i + 1 < argc)
+      engine = argv[++i];
+    else if (arg == "--policy" && i + 1 < argc)
+      policy = argv[++i];
+    else if (arg == "--threads" && i + 1 < argc)
+      THREADS = std::max<size_t>(std::strtoul(argv[++i], nullptr, 10), 1);
+    else if (arg == "--seed" && i + 1 < argc)
+      seed = std::strtoull(argv[++i], nullptr, 10);
+    else {
+      std::cerr << "Usage: lottery_bench [--min N] [--max N] [--sell P] [--engine index|event|mask] [--policy queue|vector|reserved|chunked|all] [--threads N] [--seed N]" << std::endl;
+      return 1;
+    }
+  }
+
+  if (engine != "event" && engine != "index" && engine != "mask") {
+    std::cerr << "Unknown engine: " << engine << std::endl;
+    return 1;
+  }
+
+  size_t first_policy = 0;
+  size_t end_policy = sizeof(kPolicies) / sizeof(*kPolicies);
+
+  if (policy != "all") {
+    first_policy = std::find(kPolicies, kPolicies + end_policy, policy) - kPolicies;
+
+    if (first_policy == end_policy) {
+      std::cerr << "Unknown policy: " << policy << std::endl;
+      return 1;
+    }
+
+    end_policy = first_policy + 1;
+  }
+
+  if (percentage <= 0.0 || percentage > 100.0) {
+    std::cerr << "Percentage can only be in the range (0, 100]" << std::endl;
+    return 1;
+  }
+
+  DrawEngine draw_engine = engine == "index" ? DrawEngine::kIndex : engine == "mask" ? DrawEngine::kMask : DrawEngine::kEvent;
+
+  PROGRESS = false;
+
+  printf("# lottery_bench engine=%s policy=%s sell=%g threads=%zu seed=%llu\n", engine.c_str(), policy.c_str(), percentage, THREADS, static_cast<unsigned long long>(seed));
+  if (engine != "index" && end_policy - first_policy > 1)
+    printf("# policies only change sell and draw under the index engine; under %s those rows time the same code\n", engine.c_str());
+
+  printf("%-10s %-9s %12s %12s %14s %12s\n", "stage", "policy", "tickets", "ns/unit", "units/s", "peak_rss_kb");
+  fflush(stdout);
+
+  for (size_t tickets = min_tickets; tickets <= max_tickets && tickets <= Edition<std::queue>::kMaxCount; tickets *= 10) {
+    for (size_t i = first_policy; i < end_policy; ++i) {
+      for (size_t group = 0; group < sizeof(kGroups) / sizeof(*kGroups); ++group) {
+        pid_t pid = fork();
+
+        if (pid < 0) {
+          perror("fork");
+          return 1;
+        }
+
+        // The child starts its own worker pool, as none exists in the parent
+        if (!pid) {
+          RANDOM.seed(seed);
+          bench_policy(group, i, tickets, percentage, draw_engine);
+          fflush(stdout);
+          _exit(0);
+        }
+
+        int status = 0;
+        waitpid(pid, &status, 0);
+
+        if (!WIFEXITED(status) || WEXITSTATUS(status)) {
+          printf("%-10s %-9s %12zu failed\n", kGroups[group], kPolicies[i], tickets);
+          fflush(stdout);
+        }
+      }
+    }
+
+    if (tickets > max_tickets / 10)
+      break;
+  }
+
+  return 0;
+}
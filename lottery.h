@@ -0,0 +1,4299 @@
+#ifndef LOTTERY_H
+#define LOTTERY_H
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <charconv>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <chrono>
+#include <cctype>
+#include <cmath>
+#include <cstdio>
+#include <ctime>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <numeric>
+#include <queue>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#if defined(__AVX2__) || defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+// Passes a size hint to containers that take one
+template <typename Container>
+auto reserve_hint(Container& container, size_t count, int) -> decltype(container.reserve(count), void()) {
+  container.reserve(count);
+}
+
+template <typename Container>
+void reserve_hint(Container&, size_t, long) {}
+
+// True if Container takes size hints, so callers can skip counting for ones that don't
+template <typename Container>
+constexpr auto takes_reserve_hint(int) -> decltype(std::declval<Container&>().reserve(size_t()), bool()) {
+  return true;
+}
+
+template <typename Container>
+constexpr bool takes_reserve_hint(long) {
+  return false;
+}
+
+template <typename T, typename Container>
+class Interlayer : public Container {
+public:
+  static constexpr bool kTakesHints = takes_reserve_hint<Container>(0);
+
+  T& operator[](size_t index) {
+    return this->c[index];
+  }
+
+  const T& operator[](size_t index) const {
+    return this->c[index];
+  }
+
+  template <typename Comparator>
+  void sort(Comparator func) {
+    std::sort(this->c.begin(), this->c.end(), func);
+  }
+
+  // Expected final size; std::queue ignores it
+  void reserve(size_t count) {
+    reserve_hint(static_cast<Container&>(*this), count, 0);
+  }
+};
+
+// Elements in fixed 64 KiB chunks: growing never moves them, so their addresses stay
+// valid, and reserve only sizes the chunk table
+template <typename T>
+class ChunkedArray {
+public:
+  static const size_t kChunk = std::max<size_t>((size_t(1) << 16) / sizeof(T), 1);
+
+  class iterator {
+  public:
+    using iterator_category = std::random_access_iterator_tag;
+    using value_type = T;
+    using difference_type = std::ptrdiff_t;
+    using pointer = T*;
+    using reference = T&;
+
+    iterator(ChunkedArray* array = nullptr, size_t index = 0) : array_(array), index_(index) {}
+
+    T& operator*() const {
+      return (*array_)[index_];
+    }
+
+    T* operator->() const {
+      return &(*array_)[index_];
+    }
+
+    T& operator[](difference_type n) const {
+      return (*array_)[index_ + n];
+    }
+
+    iterator& operator++() {
+      ++index_;
+      return *this;
+    }
+
+    iterator& operator--() {
+      --index_;
+      return *this;
+    }
+
+    iterator operator++(int) {
+      return iterator(array_, index_++);
+    }
+
+    iterator operator--(int) {
+      return iterator(array_, index_--);
+    }
+
+    iterator& operator+=(difference_type n) {
+      index_ += n;
+      return *this;
+    }
+
+    iterator& operator-=(difference_type n) {
+      index_ -= n;
+      return *this;
+    }
+
+    iterator operator+(difference_type n) const {
+      return iterator(array_, index_ + n);
+    }
+
+    iterator operator-(difference_type n) const {
+      return iterator(array_, index_ - n);
+    }
+
+    difference_type operator-(const iterator& other) const {
+      return static_cast<difference_type>(index_) - static_cast<difference_type>(other.index_);
+    }
+
+    bool operator==(const iterator& other) const {
+      return index_ == other.index_;
+    }
+
+    bool operator!=(const iterator& other) const {
+      return index_ != other.index_;
+    }
+
+    bool operator<(const iterator& other) const {
+      return index_ < other.index_;
+    }
+
+    bool operator>(const iterator& other) const {
+      return index_ > other.index_;
+    }
+
+    bool operator<=(const iterator& other) const {
+      return index_ <= other.index_;
+    }
+
+    bool operator>=(const iterator& other) const {
+      return index_ >= other.index_;
+    }
+
+  private:
+    ChunkedArray* array_;
+    size_t index_;
+  };
+
+  T& operator[](size_t index) {
+    return chunks_[index / kChunk][index % kChunk];
+  }
+
+  const T& operator[](size_t index) const {
+    return chunks_[index / kChunk][index % kChunk];
+  }
+
+  void push_back(const T& value) {
+    if (size_ == chunks_.size() * kChunk)
+      chunks_.emplace_back(new T[kChunk]);
+
+    (*this)[size_++] = value;
+  }
+
+  size_t size() const {
+    return size_;
+  }
+
+  bool empty() const {
+    return !size_;
+  }
+
+  T& back() {
+    return (*this)[size_ - 1];
+  }
+
+  void reserve(size_t count) {
+    chunks_.reserve((count + kChunk - 1) / kChunk);
+  }
+
+  iterator begin() {
+    return iterator(this, 0);
+  }
+
+  iterator end() {
+    return iterator(this, size_);
+  }
+
+private:
+  std::vector<std::unique_ptr<T[]>> chunks_;
+  size_t size_ = 0;
+};
+
+// Container policies for Game<T, G> and Edition<T, G>. Like std::queue, the deque-backed
+// default, a policy T<V> keeps its elements in a protected member c that Interlayer
+// indexes and sorts; policies that act on size hints add reserve(count).
+// LOTTERY_CONTAINER picks the policy of the lottery binary.
+
+// std::vector growing geometrically; size hints are ignored
+template <typename T, typename Storage = std::vector<T>>
+class VectorPolicy {
+public:
+  void push(const T& value) {
+    c.push_back(value);
+  }
+
+  size_t size() const {
+    return c.size();
+  }
+
+  bool empty() const {
+    return c.empty();
+  }
+
+  T& back() {
+    return c.back();
+  }
+
+protected:
+  Storage c;
+};
+
+// std::vector sized from the hints, so hinted containers never regrow
+template <typename T>
+class ReservedPolicy : public VectorPolicy<T> {
+public:
+  void reserve(size_t count) {
+    this->c.reserve(count);
+  }
+};
+
+// ChunkedArray: no copying on growth and stable element addresses
+template <typename T>
+class ChunkedPolicy : public VectorPolicy<T, ChunkedArray<T>> {
+public:
+  void reserve(size_t count) {
+    this->c.reserve(count);
+  }
+};
+
+#ifndef LOTTERY_CONTAINER
+#define LOTTERY_CONTAINER std::queue
+#endif
+
+template <typename T>
+using DefaultPolicy = LOTTERY_CONTAINER<T>;
+
+template <template <typename...> typename T, typename G>
+class Game;
+
+inline bool PROGRESS = true;
+
+// Progress bar of one long loop. Loops only publish how far they got through relaxed
+// atomics; while PROGRESS is set a background thread redraws the innermost live bar
+// about ten times a second, and the destructor prints the finished bar.
+class Progress {
+public:
+  Progress(size_t total, const std::string& caption, bool erase = false);
+  ~Progress();
+
+  Progress(const Progress&) = delete;
+  Progress& operator=(const Progress&) = delete;
+
+  // Position of a loop with a single writer
+  void set(size_t done) {
+    done_.store(done, std::memory_order_relaxed);
+  }
+
+  // Work finished by one of several writers
+  void add(size_t count) {
+    done_.fetch_add(count, std::memory_order_relaxed);
+  }
+
+private:
+  struct Reporter {
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::thread thread;
+    Progress* current = nullptr;
+    bool stop = false;
+
+    Reporter();
+    ~Reporter();
+  };
+
+  static const size_t kBarWidth = 40;
+
+  const size_t total_;
+  const std::string caption_;
+  const bool erase_;
+  const bool shown_;
+  std::atomic<size_t> done_{0};
+  Progress* outer_ = nullptr;
+  size_t percent_ = SIZE_MAX;
+
+  static Reporter& reporter();
+  void draw();
+};
+
+#ifndef LOTTERY_STATS
+#define LOTTERY_STATS 1
+#endif
+
+enum class Counter {
+  kTicketsGenerated,
+  kTicketsScanned,
+  kNumbersProbed,
+  kWinnersEmitted,
+  kRounds,
+  kArenaAllocations,
+  kArenaBytes,
+  kArenaChunkAllocations,
+  kCount
+};
+
+enum class Phase {
+  kGenerate,
+  kSell,
+  kIndex,
+  kRank,
+  kMatch,
+  kSettle,
+  kShow,
+  kPlay,
+  kSave,
+  kLoad,
+  kExport,
+  kCount
+};
+
+// Hot-path counters, wall time per phase and, while tracing, Chrome trace spans. Loops
+// add their counts once per block with relaxed atomics; with LOTTERY_STATS=0 every
+// call is empty and the bookkeeping is compiled out.
+class Stats {
+public:
+  using Clock = std::chrono::steady_clock;
+
+  static void count(Counter counter, uint64_t n) {
+#if LOTTERY_STATS
+    counters_[static_cast<size_t>(counter)].fetch_add(n, std::memory_order_relaxed);
+#else
+    (void)counter;
+    (void)n;
+#endif
+  }
+
+  static void add_phase(Phase phase, Clock::time_point start, Clock::time_point end) {
+#if LOTTERY_STATS
+    size_t i = static_cast<size_t>(phase);
+
+    phase_ns_[i].fetch_add(std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count(), std::memory_order_relaxed);
+    phase_calls_[i].fetch_add(1, std::memory_order_relaxed);
+    span(kPhaseNames[i], start, end);
+#else
+    (void)phase;
+    (void)start;
+    (void)end;
+#endif
+  }
+
+  // Records a complete span while tracing
+  static void span(const std::string& name, Clock::time_point start, Clock::time_point end) {
+#if LOTTERY_STATS
+    if (!tracing_.load(std::memory_order_relaxed))
+      return;
+
+    std::lock_guard<std::mutex> lock(trace_mutex_);
+    trace_.push_back({name, start, end, std::hash<std::thread::id>()(std::this_thread::get_id()) % 1000000});
+#else
+    (void)name;
+    (void)start;
+    (void)end;
+#endif
+  }
+
+  static void start_trace() {
+#if LOTTERY_STATS
+    tracing_ = true;
+#endif
+  }
+
+  static bool is_tracing() {
+#if LOTTERY_STATS
+    return tracing_.load(std::memory_order_relaxed);
+#else
+    return false;
+#endif
+  }
+
+  // Writes the recorded spans as Chrome trace JSON (chrome://tracing, Perfetto)
+  static bool write_trace(const std::string& path) {
+#if LOTTERY_STATS
+    std::lock_guard<std::mutex> lock(trace_mutex_);
+    std::ofstream file(path);
+
+    file << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+
+    for (size_t i = 0; i < trace_.size(); ++i) {
+      const Span& event = trace_[i];
+
+      file << (i ? ",\n" : "\n") << "{\"name\":\"" << event.name << "\",\"cat\":\"lottery\",\"ph\":\"X\",\"pid\":1,\"tid\":" << event.thread
+           << ",\"ts\":" << micros(event.start) << ",\"dur\":" << micros(event.end) - micros(event.start) << "}";
+    }
+
+    file << "\n]}\n";
+
+    return !file.fail();
+#else
+    (void)path;
+    return false;
+#endif
+  }
+
+  static void reset() {
+#if LOTTERY_STATS
+    for (size_t i = 0; i < static_cast<size_t>(Counter::kCount); ++i)
+      counters_[i] = 0;
+
+    for (size_t i = 0; i < static_cast<size_t>(Phase::kCount); ++i) {
+      phase_ns_[i] = 0;
+      phase_calls_[i] = 0;
+    }
+#endif
+  }
+
+  static void print(std::ostream& out) {
+#if LOTTERY_STATS
+    char line[96];
+
+    for (size_t i = 0; i < static_cast<size_t>(Counter::kCount); ++i) {
+      snprintf(line, sizeof(line), "  %-24s %16llu", kCounterNames[i], static_cast<unsigned long long>(counters_[i].load()));
+      out << line << '\n';
+    }
+
+    out << '\n';
+
+    for (size_t i = 0; i < static_cast<size_t>(Phase::kCount); ++i) {
+      snprintf(line, sizeof(line), "  %-24s %10.3f ms %10llu calls", kPhaseNames[i], phase_ns_[i].load() / 1e6, static_cast<unsigned long long>(phase_calls_[i].load()));
+      out << line << '\n';
+    }
+
+    out.flush();
+#else
+    out << "Statistics were compiled out (LOTTERY_STATS=0)" << std::endl;
+#endif
+  }
+
+  // {"counters":{name:value,...},"phases":{name:{"ms":...,"calls":...},...}}
+  static void print_json(std::ostream& out) {
+#if LOTTERY_STATS
+    out << "{\"counters\":{";
+
+    for (size_t i = 0; i < static_cast<size_t>(Counter::kCount); ++i)
+      out << (i ? "," : "") << "\"" << kCounterNames[i] << "\":" << counters_[i].load();
+
+    out << "},\"phases\":{";
+
+    for (size_t i = 0; i < static_cast<size_t>(Phase::kCount); ++i)
+      out << (i ? "," : "") << "\"" << kPhaseNames[i] << "\":{\"ms\":" << phase_ns_[i].load() / 1e6 << ",\"calls\":" << phase_calls_[i].load() << "}";
+
+    out << "}}";
+#else
+    out << "null";
+#endif
+  }
+
+private:
+#if LOTTERY_STATS
+  struct Span {
+    std::string name;
+    Clock::time_point start;
+    Clock::time_point end;
+    size_t thread;
+  };
+
+  static constexpr const char* kCounterNames[] = {"tickets_generated", "tickets_scanned", "numbers_probed", "winners_emitted", "rounds", "arena_allocations", "arena_bytes", "arena_chunk_allocations"};
+  static constexpr const char* kPhaseNames[] = {"generate", "sell", "index", "rank", "match", "settle", "show", "play", "save", "load", "export"};
+
+  static_assert(sizeof(kCounterNames) / sizeof(*kCounterNames) == static_cast<size_t>(Counter::kCount), "a name per counter");
+  static_assert(sizeof(kPhaseNames) / sizeof(*kPhaseNames) == static_cast<size_t>(Phase::kCount), "a name per phase");
+
+  static inline std::atomic<uint64_t> counters_[static_cast<size_t>(Counter::kCount)] = {};
+  static inline std::atomic<uint64_t> phase_ns_[static_cast<size_t>(Phase::kCount)] = {};
+  static inline std::atomic<uint64_t> phase_calls_[static_cast<size_t>(Phase::kCount)] = {};
+  static inline std::atomic<bool> tracing_{false};
+  static inline std::mutex trace_mutex_;
+  static inline std::vector<Span> trace_;
+  static inline const Clock::time_point origin_ = Clock::now();
+
+  static long long micros(Clock::time_point time) {
+    return std::chrono::duration_cast<std::chrono::microseconds>(time - origin_).count();
+  }
+#endif
+};
+
+// Adds the wall time of its scope to a phase
+class PhaseTimer {
+public:
+#if LOTTERY_STATS
+  explicit PhaseTimer(Phase phase) : phase_(phase), start_(Stats::Clock::now()) {}
+
+  ~PhaseTimer() {
+    Stats::add_phase(phase_, start_, Stats::Clock::now());
+  }
+
+private:
+  Phase phase_;
+  Stats::Clock::time_point start_;
+#else
+  explicit PhaseTimer(Phase) {}
+#endif
+
+  PhaseTimer(const PhaseTimer&) = delete;
+  PhaseTimer& operator=(const PhaseTimer&) = delete;
+};
+
+#ifndef LOTTERY_RNG
+#define LOTTERY_RNG kXoshiro
+#endif
+
+enum class RngKind {
+  kSplitMix,
+  kXoshiro,
+  kPcg,
+  kPhilox
+};
+
+// Generator used for new editions and sequential draws; compile-time default, --rng at run time
+inline RngKind RNG = RngKind::LOTTERY_RNG;
+
+// SplitMix64 as a counter-based generator: output n of a stream depends only on
+// (seed, stream, n), so every ticket can be generated independently of the others
+class SplitMix64 {
+public:
+  SplitMix64(uint64_t seed = 0, uint64_t stream = 0) : key_(mix(seed ^ mix(stream + kGamma))) {}
+
+  uint64_t operator()() {
+    return mix(key_ + ++counter_ * kGamma);
+  }
+
+private:
+  static const uint64_t kGamma = 0x9E3779B97F4A7C15;
+
+  uint64_t key_;
+  uint64_t counter_ = 0;
+
+  static uint64_t mix(uint64_t x) {
+    x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9;
+    x = (x ^ (x >> 27)) * 0x94D049BB133111EB;
+
+    return x ^ (x >> 31);
+  }
+};
+
+// xoshiro256** (Blackman, Vigna), state filled from SplitMix64(seed, stream)
+class Xoshiro256 {
+public:
+  Xoshiro256(uint64_t seed = 0, uint64_t stream = 0) {
+    SplitMix64 init(seed, stream);
+
+    for (size_t i = 0; i < 4; ++i)
+      s_[i] = init();
+  }
+
+  uint64_t operator()() {
+    uint64_t result = rotl(s_[1] * 5, 7) * 9;
+    uint64_t t = s_[1] << 17;
+
+    s_[2] ^= s_[0];
+    s_[3] ^= s_[1];
+    s_[1] ^= s_[2];
+    s_[0] ^= s_[3];
+    s_[2] ^= t;
+    s_[3] = rotl(s_[3], 45);
+
+    return result;
+  }
+
+private:
+  uint64_t s_[4];
+
+  static uint64_t rotl(uint64_t x, int k) {
+    return x << k | x >> (64 - k);
+  }
+};
+
+// PCG64 (XSL RR 128/64, O'Neill), stream selects the increment
+class Pcg64 {
+public:
+  Pcg64(uint64_t seed = 0, uint64_t stream = 0) {
+    SplitMix64 init(seed, stream);
+
+    inc_ = (static_cast<unsigned __int128>(init()) << 64 | init()) | 1;
+    state_ = inc_ + (static_cast<unsigned __int128>(init()) << 64 | init());
+    (*this)();
+  }
+
+  uint64_t operator()() {
+    const unsigned __int128 kMultiplier = static_cast<unsigned __int128>(0x2360ED051FC65DA4) << 64 | 0x4385DF649FCCF645;
+
+    state_ = state_ * kMultiplier + inc_;
+
+    uint64_t x = static_cast<uint64_t>(state_ >> 64) ^ static_cast<uint64_t>(state_);
+    unsigned rot = static_cast<unsigned>(state_ >> 122);
+
+    return x >> rot | x << ((64 - rot) & 63);
+  }
+
+private:
+  unsigned __int128 state_;
+  unsigned __int128 inc_;
+};
+
+// Philox4x32-10 (Salmon et al.): key from seed, counter high words from stream
+class Philox4x32 {
+public:
+  Philox4x32(uint64_t seed = 0, uint64_t stream = 0) : key_{static_cast<uint32_t>(seed), static_cast<uint32_t>(seed >> 32)}, counter_{0, 0, static_cast<uint32_t>(stream), static_cast<uint32_t>(stream >> 32)} {}
+
+  uint64_t operator()() {
+    if (index_ == 4) {
+      refill();
+      index_ = 0;
+    }
+
+    uint64_t result = static_cast<uint64_t>(block_[index_]) << 32 | block_[index_ + 1];
+    index_ += 2;
+
+    return result;
+  }
+
+private:
+  uint32_t key_[2];
+  uint32_t counter_[4];
+  uint32_t block_[4];
+  size_t index_ = 4;
+
+  void refill() {
+    uint32_t x[4] = {counter_[0], counter_[1], counter_[2], counter_[3]};
+    uint32_t k[2] = {key_[0], key_[1]};
+
+    for (size_t round = 0; round < 10; ++round) {
+      uint64_t p0 = uint64_t(0xD2511F53) * x[0];
+      uint64_t p1 = uint64_t(0xCD9E8D57) * x[2];
+
+      x[0] = static_cast<uint32_t>(p1 >> 32) ^ x[1] ^ k[0];
+      x[1] = static_cast<uint32_t>(p1);
+      x[2] = static_cast<uint32_t>(p0 >> 32) ^ x[3] ^ k[1];
+      x[3] = static_cast<uint32_t>(p0);
+      k[0] += 0x9E3779B9;
+      k[1] += 0xBB67AE85;
+    }
+
+    std::copy(x, x + 4, block_);
+
+    if (!++counter_[0])
+      ++counter_[1];
+  }
+};
+
+// Calls func(rng) with a generator of the given kind for (seed, stream)
+template <typename Func>
+void with_rng(RngKind kind, uint64_t seed, uint64_t stream, Func func) {
+  switch (kind) {
+  case RngKind::kSplitMix: {
+    SplitMix64 rng(seed, stream);
+    func(rng);
+    break;
+  }
+  case RngKind::kXoshiro: {
+    Xoshiro256 rng(seed, stream);
+    func(rng);
+    break;
+  }
+  case RngKind::kPcg: {
+    Pcg64 rng(seed, stream);
+    func(rng);
+    break;
+  }
+  case RngKind::kPhilox: {
+    Philox4x32 rng(seed, stream);
+    func(rng);
+    break;
+  }
+  }
+}
+
+// Unbiased integer in [0, range) by Lemire's multiply-shift with rejection
+template <typename Rng>
+uint64_t bounded(Rng& rng, uint64_t range) {
+  unsigned __int128 product = static_cast<unsigned __int128>(rng()) * range;
+
+  if (static_cast<uint64_t>(product) < range) {
+    uint64_t threshold = -range % range;
+
+    while (static_cast<uint64_t>(product) < threshold)
+      product = static_cast<unsigned __int128>(rng()) * range;
+  }
+
+  return static_cast<uint64_t>(product >> 64);
+}
+
+// Sequential generator of the kind selected when seeded
+class Random {
+public:
+  explicit Random(uint64_t seed) {
+    this->seed(seed);
+  }
+
+  void seed(uint64_t seed) {
+    kind_ = RNG;
+    splitmix_ = SplitMix64(seed);
+    xoshiro_ = Xoshiro256(seed);
+    pcg_ = Pcg64(seed);
+    philox_ = Philox4x32(seed);
+  }
+
+  uint64_t operator()() {
+    switch (kind_) {
+    case RngKind::kSplitMix:
+      return splitmix_();
+    case RngKind::kXoshiro:
+      return xoshiro_();
+    case RngKind::kPcg:
+      return pcg_();
+    default:
+      return philox_();
+    }
+  }
+
+private:
+  RngKind kind_;
+  SplitMix64 splitmix_;
+  Xoshiro256 xoshiro_;
+  Pcg64 pcg_;
+  Philox4x32 philox_;
+};
+
+inline thread_local Random RANDOM(time(nullptr));
+
+inline uint64_t rnd_gen() {
+  return RANDOM();
+}
+
+inline uint64_t rnd_below(uint64_t range) {
+  return bounded(RANDOM, range);
+}
+
+// Fixed set of workers running chunked jobs; the calling thread is worker 0. Each
+// worker starts on its own contiguous share of chunks and, once it runs dry,
+// steals the back half of another worker's share.
+class ThreadPool {
+public:
+  explicit ThreadPool(size_t threads) : shares_(new std::atomic<uint64_t>[threads]), size_(threads) {
+    for (size_t i = 1; i < size_; ++i)
+      workers_.emplace_back(&ThreadPool::loop, this, i);
+  }
+
+  ~ThreadPool() {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      stop_ = true;
+    }
+
+    wake_.notify_all();
+
+    for (size_t i = 0; i < workers_.size(); ++i)
+      workers_[i].join();
+  }
+
+  size_t size() const {
+    return size_;
+  }
+
+  // Calls func(chunk, worker) once for every chunk in [0, chunks)
+  template <typename Func>
+  void run(size_t chunks, Func func) {
+    if (!chunks)
+      return;
+
+    // Jobs started from inside a job run inline on the calling worker
+    if (nested_) {
+      for (size_t i = 0; i < chunks; ++i)
+        func(i, 0);
+
+      return;
+    }
+
+    for (size_t i = 0; i < size_; ++i)
+      shares_[i].store(pack(chunks * i / size_, chunks * (i + 1) / size_));
+
+    auto job = [this, &func](size_t worker) {
+      nested_ = true;
+
+      for (size_t chunk; take(worker, chunk) || steal(worker, chunk);)
+        func(chunk, worker);
+
+      nested_ = false;
+    };
+
+    if (size_ == 1) {
+      job(0);
+      return;
+    }
+
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      job_ = job;
+      pending_ = size_ - 1;
+      ++generation_;
+    }
+
+    wake_.notify_all();
+    job(0);
+
+    std::unique_lock<std::mutex> lock(mutex_);
+    done_.wait(lock, [this] { return !pending_; });
+    job_ = nullptr;
+  }
+
+private:
+  std::unique_ptr<std::atomic<uint64_t>[]> shares_;
+  size_t size_;
+  std::vector<std::thread> workers_;
+
+  std::mutex mutex_;
+  std::condition_variable wake_;
+  std::condition_variable done_;
+  std::function<void(size_t)> job_;
+  size_t pending_ = 0;
+  size_t generation_ = 0;
+  bool stop_ = false;
+
+  static inline thread_local bool nested_ = false;
+
+  static uint64_t pack(uint64_t begin, uint64_t end) {
+    return begin << 32 | end;
+  }
+
+  bool take(size_t worker, size_t& chunk) {
+    uint64_t share = shares_[worker].load();
+
+    while (share >> 32 < (share & UINT32_MAX)) {
+      if (shares_[worker].compare_exchange_weak(share, share + (uint64_t(1) << 32))) {
+        chunk = share >> 32;
+        return true;
+      }
+    }
+
+    return false;
+  }
+
+  bool steal(size_t worker, size_t& chunk) {
+    for (size_t i = 1; i < size_; ++i) {
+      std::atomic<uint64_t>& victim = shares_[(worker + i) % size_];
+      uint64_t share = victim.load();
+
+      while (share >> 32 < (share & UINT32_MAX)) {
+        uint64_t begin = share >> 32;
+        uint64_t end = share & UINT32_MAX;
+        uint64_t middle = begin + (end - begin) / 2;
+
+        if (victim.compare_exchange_weak(share, pack(begin, middle))) {
+          chunk = middle;
+          shares_[worker].store(pack(middle + 1, end));
+          return true;
+        }
+      }
+    }
+
+    return false;
+  }
+
+  void loop(size_t worker) {
+    size_t seen = 0;
+
+    while (true) {
+      std::function<void(size_t)> job;
+
+      {
+        std::unique_lock<std::mutex> lock(mutex_);
+        wake_.wait(lock, [this, seen] { return stop_ || generation_ != seen; });
+
+        if (stop_)
+          return;
+
+        seen = generation_;
+        job = job_;
+      }
+
+      job(worker);
+
+      std::lock_guard<std::mutex> lock(mutex_);
+
+      if (!--pending_)
+        done_.notify_one();
+    }
+  }
+};
+
+inline size_t THREADS = std::max<size_t>(std::thread::hardware_concurrency(), 1);
+
+inline ThreadPool& pool() {
+  static ThreadPool instance(THREADS);
+  return instance;
+}
+
+// Calls func(begin, end, worker) for blocks of [0, count) on the pool
+template <typename Func>
+void parallel_for(size_t count, size_t block, const std::string& caption, Func func, bool erase = false) {
+  Progress progress(count, caption, erase);
+
+  pool().run((count + block - 1) / block, [&](size_t chunk, size_t worker) {
+    size_t begin = chunk * block;
+    size_t end = std::min(begin + block, count);
+
+    func(begin, end, worker);
+    progress.add(end - begin);
+  });
+}
+
+// Per-worker output buffers of a parallel_for, merged back in block order
+template <typename Value>
+class BlockBuffers {
+public:
+  explicit BlockBuffers(size_t workers) : buffers_(workers) {}
+
+  void push(size_t worker, size_t block, const Value& value) {
+    Buffer& buffer = buffers_[worker];
+
+    if (buffer.runs.empty() || buffer.runs.back().first != block)
+      buffer.runs.emplace_back(block, buffer.values.size());
+
+    buffer.values.push_back(value);
+  }
+
+  size_t size() const {
+    size_t result = 0;
+
+    for (size_t i = 0; i < buffers_.size(); ++i)
+      result += buffers_[i].values.size();
+
+    return result;
+  }
+
+  // Empties the buffers, keeping their memory for the next scan
+  void clear() {
+    for (size_t i = 0; i < buffers_.size(); ++i) {
+      buffers_[i].values.clear();
+      buffers_[i].runs.clear();
+    }
+  }
+
+  // Writes all values to result[0, size())
+  void merge(Value* result) const {
+    // (block, worker, run index)
+    std::vector<std::tuple<size_t, size_t, size_t>> runs;
+
+    for (size_t i = 0; i < buffers_.size(); ++i) {
+      for (size_t j = 0; j < buffers_[i].runs.size(); ++j)
+        runs.emplace_back(buffers_[i].runs[j].first, i, j);
+    }
+
+    std::sort(runs.begin(), runs.end());
+
+    for (size_t i = 0; i < runs.size(); ++i) {
+      const Buffer& buffer = buffers_[std::get<1>(runs[i])];
+      size_t run = std::get<2>(runs[i]);
+      size_t end = run + 1 < buffer.runs.size() ? buffer.runs[run + 1].second : buffer.values.size();
+
+      result = std::copy(buffer.values.begin() + buffer.runs[run].second, buffer.values.begin() + end, result);
+    }
+  }
+
+private:
+  struct Buffer {
+    std::vector<Value> values;
+    // (block, first value index)
+    std::vector<std::pair<size_t, size_t>> runs;
+  };
+
+  std::vector<Buffer> buffers_;
+};
+
+// Bump allocator for trivially destructible objects, all released with the arena
+class Arena {
+public:
+  static const size_t kChunkSize = 1 << 16;
+
+  Arena() = default;
+  Arena(const Arena&) = delete;
+  Arena& operator=(const Arena&) = delete;
+
+  template <typename Value>
+  Value* allocate(size_t count) {
+    static_assert(std::is_trivially_destructible<Value>::value, "Arena never runs destructors");
+
+    size_t size = count * sizeof(Value);
+
+    Stats::count(Counter::kArenaAllocations, 1);
+    Stats::count(Counter::kArenaBytes, size);
+
+    // Arrays larger than a chunk get memory of their own
+    if (size > kChunkSize) {
+      Stats::count(Counter::kArenaChunkAllocations, 1);
+      large_.emplace_back(new char[size]);
+      return reinterpret_cast<Value*>(large_.back().get());
+    }
+
+    size_t offset = (used_ + alignof(Value) - 1) / alignof(Value) * alignof(Value);
+
+    if (chunks_.empty() || offset + size > kChunkSize) {
+      Stats::count(Counter::kArenaChunkAllocations, 1);
+      chunks_.emplace_back(new char[kChunkSize]);
+      offset = 0;
+    }
+
+    used_ = offset + size;
+
+    return reinterpret_cast<Value*>(chunks_.back().get() + offset);
+  }
+
+  template <typename Value, typename... Args>
+  Value* make(Args&&... args) {
+    return new (allocate<Value>(1)) Value(std::forward<Args>(args)...);
+  }
+
+private:
+  std::vector<std::unique_ptr<char[]>> chunks_;
+  std::vector<std::unique_ptr<char[]>> large_;
+  size_t used_ = 0;
+};
+
+template <typename T, typename Container = T>
+void shuffle(Container& list, size_t count) {
+  for (size_t i = 0; i < count; ++i)
+    std::swap(list[i], list[rnd_below(i + 1)]);
+}
+
+// Most balls of any format; sizes round records, snapshots and exports
+const size_t kMaxBalls = 90;
+
+// Ticket format: rows x cols distinct numbers out of 1..max_num. Rounds complete a row,
+// then a half card (an aligned run of half_rows rows), then the whole card; with
+// half_rows == rows (odd row counts) the second round already needs the whole card.
+// Editions and games are instantiated per format, so the draw loops see constants.
+template <size_t Rows, size_t Cols, unsigned char MaxNum, size_t HalfRows = Rows % 2 ? Rows : Rows / 2>
+struct Geometry {
+  static constexpr size_t rows = Rows;
+  static constexpr size_t cols = Cols;
+  static constexpr unsigned char max_num = MaxNum;
+  static constexpr size_t half_rows = HalfRows;
+  static constexpr size_t nums = Rows * Cols;
+
+  static_assert(Rows >= 1 && Rows <= 8, "row completion is kept in a byte");
+  static_assert(Rows % HalfRows == 0, "half cards tile the card");
+  static_assert(Rows * Cols <= MaxNum && MaxNum <= kMaxBalls, "numbers are distinct balls");
+
+  // Kind of round `round_number` (from 0): 0 row, 1 half card, 2 card
+  static constexpr size_t round_kind(size_t round_number) {
+    return round_number == 0 ? 0 : round_number == 1 && HalfRows < Rows ? 1 : 2;
+  }
+
+  // Numbers a ticket needs drawn to win round `round_number`
+  static constexpr size_t round_nums(size_t round_number) {
+    return round_kind(round_number) == 0 ? Cols : round_kind(round_number) == 1 ? HalfRows * Cols : Rows * Cols;
+  }
+};
+
+// 6x5 of 90, top or bottom half (the original format)
+using Lotto90 = Geometry<6, 5, 90>;
+// 3x9 of 90, a line, then a full house
+using Bingo90 = Geometry<3, 9, 90>;
+// 5x5 of 75, a line, then a blackout
+using Bingo75 = Geometry<5, 5, 75>;
+
+enum class TicketFormat {
+  kLotto90,
+  kBingo90,
+  kBingo75
+};
+
+// Calls func with a value of the format's Geometry type
+template <typename Func>
+decltype(auto) with_format(TicketFormat format, Func func) {
+  switch (format) {
+  case TicketFormat::kBingo90:
+    return func(Bingo90());
+  case TicketFormat::kBingo75:
+    return func(Bingo75());
+  default:
+    return func(Lotto90());
+  }
+}
+
+template <typename G>
+class TicketStore;
+
+// Lightweight view of one ticket of a TicketStore, holding a copy of its numbers
+template <typename G>
+class Ticket {
+public:
+  static const size_t price = 100;
+  static const size_t rows = G::rows;
+  static const size_t cols = G::cols;
+  static const unsigned char max_num = G::max_num;
+
+  const size_t id;
+
+  Ticket(const TicketStore<G>& store, size_t pos, size_t id);
+
+  unsigned char num(size_t index) const {
+    return nums_[index];
+  }
+
+  bool is_purchased() const;
+  bool is_winner() const;
+  size_t prize() const;
+
+  // Distinct numbers by a partial Fisher-Yates shuffle of 1..max_num; every 64-bit
+  // output of rng feeds two 32-bit bounded draws
+  template <typename Rng>
+  static void generate_nums(unsigned char* nums, Rng& rng) {
+    unsigned char pool[max_num];
+    uint64_t bits = 0;
+    bool spare = false;
+
+    std::iota(pool, pool + max_num, 1);
+
+    auto next = [&]() -> uint32_t {
+      spare = !spare;
+
+      if (!spare)
+        return static_cast<uint32_t>(bits >> 32);
+
+      bits = rng();
+
+      return static_cast<uint32_t>(bits);
+    };
+
+    for (uint32_t i = 0; i < rows * cols; ++i) {
+      uint32_t range = max_num - i;
+      uint64_t product = static_cast<uint64_t>(next()) * range;
+
+      if (static_cast<uint32_t>(product) < range) {
+        uint32_t threshold = -range % range;
+
+        while (static_cast<uint32_t>(product) < threshold)
+          product = static_cast<uint64_t>(next()) * range;
+      }
+
+      std::swap(pool[i], pool[i + (product >> 32)]);
+      nums[i] = pool[i];
+    }
+  }
+
+private:
+  const TicketStore<G>& store_;
+  const size_t pos_;
+  unsigned char nums_[rows * cols];
+};
+
+// Structure-of-arrays storage of an edition's tickets, addressed by position.
+// Virtual stores keep no numbers and recompute them from (seed, ticket ID).
+template <typename G>
+class TicketStore {
+public:
+  static const size_t kNums = G::nums;
+
+  // Ticket at position pos uses generator stream first_stream + pos; mapped_nums, if
+  // given, holds the numbers of all tickets and is used in place
+  TicketStore(size_t count, size_t first_stream, uint64_t seed, RngKind rng, bool virtual_nums, const unsigned char* mapped_nums = nullptr) : count_(count), first_stream_(first_stream), seed_(seed), rng_(rng), virtual_(virtual_nums), nums_(virtual_nums || mapped_nums ? 0 : count * kNums), nums_data_(mapped_nums ? mapped_nums : nums_.data()), purchased_((count + 63) / 64), winners_((count + 63) / 64) {}
+
+  size_t size() const {
+    return count_;
+  }
+
+  bool is_virtual() const {
+    return virtual_;
+  }
+
+  bool is_released() const {
+    return count_ && purchased_.empty();
+  }
+
+  size_t first_stream() const {
+    return first_stream_;
+  }
+
+  uint64_t seed() const {
+    return seed_;
+  }
+
+  RngKind rng() const {
+    return rng_;
+  }
+
+  // Writes the numbers of positions [begin, end) in place, dispatching on the generator once
+  void generate(size_t begin, size_t end) {
+    with_rng(rng_, seed_, 0, [this, begin, end](auto& kind) {
+      using Rng = std::decay_t<decltype(kind)>;
+
+      for (size_t pos = begin; pos < end; ++pos) {
+        Rng rng(seed_, first_stream_ + pos);
+        Ticket<G>::generate_nums(&nums_[pos * kNums], rng);
+      }
+    });
+  }
+
+  void load_nums(size_t pos, unsigned char* result) const {
+    if (!virtual_) {
+      std::copy(nums(pos), nums(pos) + kNums, result);
+      return;
+    }
+
+    with_rng(rng_, seed_, first_stream_ + pos, [result](auto& rng) { Ticket<G>::generate_nums(result, rng); });
+  }
+
+  const unsigned char* nums(size_t pos) const {
+    return nums_data_ + pos * kNums;
+  }
+
+  const std::vector<uint64_t>& purchased() const {
+    return purchased_;
+  }
+
+  const std::vector<uint64_t>& winners() const {
+    return winners_;
+  }
+
+  const std::vector<std::pair<size_t, size_t>>& prizes() const {
+    return prizes_;
+  }
+
+  // Copies saved bitsets and (position, prize) pairs back in
+  void restore(const uint64_t* purchased, const uint64_t* winners, const uint64_t* prizes, size_t prize_count) {
+    std::copy(purchased, purchased + purchased_.size(), purchased_.begin());
+    std::copy(winners, winners + winners_.size(), winners_.begin());
+    prizes_.resize(prize_count);
+
+    for (size_t i = 0; i < prize_count; ++i)
+      prizes_[i] = std::make_pair(prizes[2 * i], prizes[2 * i + 1]);
+  }
+
+  void set_purchased(size_t pos) {
+    purchased_[pos / 64] |= uint64_t(1) << (pos % 64);
+  }
+
+  bool is_purchased(size_t pos) const {
+    return purchased_[pos / 64] >> (pos % 64) & 1;
+  }
+
+  bool is_winner(size_t pos) const {
+    return winners_[pos / 64] >> (pos % 64) & 1;
+  }
+
+  // Marks positions (ascending) as winners of one round
+  void set_winners(const uint32_t* positions, size_t count, size_t prize) {
+    size_t middle = prizes_.size();
+
+    for (size_t i = 0; i < count; ++i) {
+      winners_[positions[i] / 64] |= uint64_t(1) << (positions[i] % 64);
+      prizes_.emplace_back(positions[i], prize);
+    }
+
+    std::inplace_merge(prizes_.begin(), prizes_.begin() + middle, prizes_.end());
+  }
+
+  void release() {
+    nums_ = std::vector<unsigned char>();
+    nums_data_ = nullptr;
+    purchased_ = std::vector<uint64_t>();
+    winners_ = std::vector<uint64_t>();
+    prizes_ = std::vector<std::pair<size_t, size_t>>();
+  }
+
+  size_t prize(size_t pos) const {
+    auto it = std::lower_bound(prizes_.begin(), prizes_.end(), std::make_pair(pos, size_t(0)));
+
+    return it != prizes_.end() && it->first == pos ? it->second : 0;
+  }
+
+private:
+  size_t count_;
+  size_t first_stream_;
+  uint64_t seed_;
+  RngKind rng_;
+  bool virtual_;
+  std::vector<unsigned char> nums_;
+  const unsigned char* nums_data_;
+  std::vector<uint64_t> purchased_;
+  std::vector<uint64_t> winners_;
+
+  // Sparse prize column: (position, prize) of winners sorted by position
+  std::vector<std::pair<size_t, size_t>> prizes_;
+};
+
+template <typename G>
+Ticket<G>::Ticket(const TicketStore<G>& store, size_t pos, size_t id) : id(id), store_(store), pos_(pos) {
+  store_.load_nums(pos_, nums_);
+}
+
+template <typename G>
+bool Ticket<G>::is_purchased() const {
+  return store_.is_purchased(pos_);
+}
+
+template <typename G>
+bool Ticket<G>::is_winner() const {
+  return store_.is_winner(pos_);
+}
+
+template <typename G>
+size_t Ticket<G>::prize() const {
+  return store_.prize(pos_);
+}
+
+enum class DrawEngine {
+  kIndex,
+  kMask,
+  kEvent
+};
+
+struct alignas(16) BallMask {
+  uint64_t words[2] = {0, 0};
+
+  void set(unsigned char num) {
+    words[(num - 1) / 64] |= uint64_t(1) << ((num - 1) % 64);
+  }
+};
+
+static_assert(kMaxBalls <= 128, "BallMask holds at most 128 balls");
+
+template <typename G>
+void pack_rows(const unsigned char* nums, BallMask* rows) {
+  for (size_t i = 0; i < G::rows; ++i) {
+    rows[i] = BallMask();
+
+    for (size_t j = 0; j < G::cols; ++j)
+      rows[i].set(nums[i * G::cols + j]);
+  }
+}
+
+// Sets bit r of complete[i] when row r of ticket i has no undrawn numbers; the row
+// loops run over the format's constant row count
+template <typename G>
+void match_rows(const BallMask* rows, size_t count, const BallMask& drawn, unsigned char* complete) {
+#if defined(__AVX2__)
+  const __m256i pending = _mm256_broadcastsi128_si256(_mm_load_si128(reinterpret_cast<const __m128i*>(&drawn)));
+  const __m256i zero = _mm256_setzero_si256();
+#elif defined(__SSE2__)
+  const __m128i pending = _mm_load_si128(reinterpret_cast<const __m128i*>(&drawn));
+  const __m128i zero = _mm_setzero_si128();
+#endif
+
+  for (size_t i = 0; i < count; ++i, rows += G::rows) {
+    unsigned bits = 0;
+    size_t r = 0;
+
+#if defined(__AVX2__)
+    for (; r + 1 < G::rows; r += 2) {
+      __m256i rest = _mm256_andnot_si256(pending, _mm256_loadu_si256(reinterpret_cast<const __m256i*>(rows + r)));
+      unsigned lanes = _mm256_movemask_pd(_mm256_castsi256_pd(_mm256_cmpeq_epi64(rest, zero)));
+
+      bits |= ((lanes & 3) == 3) << r | ((lanes >> 2) == 3) << (r + 1);
+    }
+#elif defined(__SSE2__)
+    for (; r < G::rows; ++r) {
+      __m128i rest = _mm_andnot_si128(pending, _mm_load_si128(reinterpret_cast<const __m128i*>(rows + r)));
+
+      bits |= (_mm_movemask_epi8(_mm_cmpeq_epi8(rest, zero)) == 0xFFFF) << r;
+    }
+#endif
+
+    for (; r < G::rows; ++r)
+      bits |= !(rows[r].words[0] & ~drawn.words[0] || rows[r].words[1] & ~drawn.words[1]) << r;
+
+    complete[i] = static_cast<unsigned char>(bits);
+  }
+}
+
+// Balls of one round in draw order
+class Balls {
+public:
+  template <typename Container>
+  Balls(const Container& combination, size_t first, size_t count) : size_(static_cast<uint8_t>(count)) {
+    for (size_t i = 0; i < count; ++i)
+      nums_[i] = combination[first + i];
+  }
+
+  size_t size() const {
+    return size_;
+  }
+
+  uint8_t operator[](size_t index) const {
+    return nums_[index];
+  }
+
+private:
+  std::array<uint8_t, kMaxBalls> nums_;
+  uint8_t size_;
+};
+
+// Balls of one play, kept up to date ball by ball: the drawn set as a mask, the window
+// of the current round, the caption of the next scan and the scan's winner buffers.
+// Game::play owns one per play, so a ball costs O(1) besides the scan itself.
+template <typename G>
+class DrawSession {
+public:
+  DrawSession() : winners_(pool().size()) {}
+
+  DrawSession(const DrawSession&) = delete;
+  DrawSession& operator=(const DrawSession&) = delete;
+
+  void push(unsigned char ball) {
+    balls_[size_++] = ball;
+    drawn_.set(ball);
+    update_caption();
+  }
+
+  // Starts the next round with the next ball
+  void close_round() {
+    first_ = size_;
+  }
+
+  size_t size() const {
+    return size_;
+  }
+
+  unsigned char back() const {
+    return balls_[size_ - 1];
+  }
+
+  const BallMask& drawn() const {
+    return drawn_;
+  }
+
+  size_t round_size() const {
+    return size_ - first_;
+  }
+
+  Balls round_balls() const {
+    return Balls(balls_, first_, size_ - first_);
+  }
+
+  // "Searching for balls " and the round's balls, beyond nine only the first and
+  // last four
+  const std::string& caption() const {
+    return caption_;
+  }
+
+  // Emptied winner buffers for the next scan
+  BlockBuffers<uint32_t>& winners() {
+    winners_.clear();
+    return winners_;
+  }
+
+private:
+  static const size_t kShownNearShrinking = 4;
+  static const size_t kShownWithoutShrinking = 9;
+
+  unsigned char balls_[G::max_num];
+  size_t size_ = 0;
+  size_t first_ = 0;
+  BallMask drawn_;
+  std::string caption_;
+  BlockBuffers<uint32_t> winners_;
+
+  // Rebuilds the caption from at most kShownWithoutShrinking balls
+  void update_caption() {
+    size_t count = round_size();
+    bool shrink = count > kShownWithoutShrinking;
+
+    caption_ = "Searching for balls ";
+
+    for (size_t i = 0; i < count; ++i) {
+      if (shrink && i == kShownNearShrinking) {
+        caption_ += ", ...";
+        i = count - kShownNearShrinking - 1;
+        continue;
+      }
+
+      if (i)
+        caption_ += ", ";
+
+      if (balls_[first_ + i] < 10)
+        caption_ += "0";
+
+      caption_ += std::to_string(balls_[first_ + i]);
+    }
+  }
+};
+
+// Winner ticket IDs of one round, stored as ascending positions within the edition
+class WinnerIds {
+public:
+  WinnerIds(const uint32_t* positions, size_t count, size_t min_id) : positions_(positions), size_(count), min_id_(min_id) {}
+
+  size_t size() const {
+    return size_;
+  }
+
+  size_t operator[](size_t index) const {
+    return min_id_ + positions_[index];
+  }
+
+private:
+  const uint32_t* positions_;
+  size_t size_;
+  size_t min_id_;
+};
+
+// Result of one round; the winner positions live in the owning edition's arena
+class Round {
+public:
+  const bool missed_numbers;
+  const Balls combination;
+  const WinnerIds winners;
+  const size_t prize;
+
+  Round(const Balls& combination, const WinnerIds& winners, size_t prize, bool missed_numbers = false) : missed_numbers(missed_numbers), combination(combination), winners(winners), prize(prize) {}
+};
+
+// File written in large blocks from its own buffer, with integer formatting that
+// bypasses iostreams
+class OutputFile {
+public:
+  static const size_t kBufferSize = 1 << 22;
+
+  explicit OutputFile(const std::string& path) : file_(path, std::ios::binary | std::ios::trunc) {
+    buffer_.reserve(kBufferSize);
+  }
+
+  OutputFile(const OutputFile&) = delete;
+  OutputFile& operator=(const OutputFile&) = delete;
+
+  bool is_open() const {
+    return file_.is_open();
+  }
+
+  void write(const void* data, size_t size) {
+    const char* bytes = static_cast<const char*>(data);
+
+    written_ += size;
+
+    if (buffer_.size() + size > kBufferSize) {
+      flush();
+
+      if (size >= kBufferSize) {
+        file_.write(bytes, size);
+        return;
+      }
+    }
+
+    buffer_.insert(buffer_.end(), bytes, bytes + size);
+  }
+
+  void put(char c) {
+    if (buffer_.size() == kBufferSize)
+      flush();
+
+    buffer_.push_back(c);
+    ++written_;
+  }
+
+  void put(const char* text) {
+    write(text, std::strlen(text));
+  }
+
+  void put(uint64_t value) {
+    char digits[20];
+    char* end = std::to_chars(digits, digits + sizeof(digits), value).ptr;
+
+    write(digits, end - digits);
+  }
+
+  // Zero bytes up to the next multiple of 8 of the bytes written so far
+  void align() {
+    const char zeros[8] = {};
+
+    write(zeros, (8 - written_ % 8) % 8);
+  }
+
+  bool close() {
+    flush();
+    file_.close();
+
+    return !file_.fail();
+  }
+
+private:
+  std::ofstream file_;
+  std::vector<char> buffer_;
+  size_t written_ = 0;
+
+  void flush() {
+    file_.write(buffer_.data(), buffer_.size());
+    buffer_.clear();
+  }
+};
+
+// Text formatted into a reusable buffer and handed to a stream in one write on flush()
+class OutputSink {
+public:
+  explicit OutputSink(std::ostream& out) : out_(out) {}
+
+  OutputSink& operator<<(char c) {
+    text_.push_back(c);
+    return *this;
+  }
+
+  OutputSink& operator<<(const char* text) {
+    text_.append(text);
+    return *this;
+  }
+
+  OutputSink& operator<<(const std::string& text) {
+    text_.append(text);
+    return *this;
+  }
+
+  template <typename Int, typename = std::enable_if_t<std::is_integral<Int>::value && !std::is_same<Int, char>::value && !std::is_same<Int, bool>::value>>
+  OutputSink& operator<<(Int value) {
+    char digits[24];
+    char* end = std::to_chars(digits, digits + sizeof(digits), value).ptr;
+
+    text_.append(digits, end - digits);
+    return *this;
+  }
+
+  void flush() {
+    if (text_.empty())
+      return;
+
+    out_.write(text_.data(), text_.size());
+    out_.flush();
+    text_.clear();
+  }
+
+private:
+  std::ostream& out_;
+  std::string text_;
+};
+
+// Read-only private mapping of a whole file; data() is null if it cannot be mapped
+class MappedFile {
+public:
+  explicit MappedFile(const std::string& path) {
+    int fd = open(path.c_str(), O_RDONLY);
+
+    if (fd < 0)
+      return;
+
+    struct stat info;
+
+    if (!fstat(fd, &info) && info.st_size > 0) {
+      void* data = mmap(nullptr, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+
+      if (data != MAP_FAILED) {
+        data_ = static_cast<const unsigned char*>(data);
+        size_ = info.st_size;
+      }
+    }
+
+    close(fd);
+  }
+
+  MappedFile(const MappedFile&) = delete;
+  MappedFile& operator=(const MappedFile&) = delete;
+
+  ~MappedFile() {
+    if (data_)
+      munmap(const_cast<unsigned char*>(data_), size_);
+  }
+
+  const unsigned char* data() const {
+    return data_;
+  }
+
+  size_t size() const {
+    return size_;
+  }
+
+private:
+  const unsigned char* data_ = nullptr;
+  size_t size_ = 0;
+};
+
+// Edition snapshot, in native byte order: SnapshotHeader, then sections starting on
+// kSnapshotAlign boundaries: ticket numbers (none for virtual editions), purchased and
+// winner bitsets, (position, prize) pairs as uint64_t, and rounds. Each round is a
+// SnapshotRound followed by its uint32_t winner positions padded to 8 bytes; the
+// jackpot, if any, comes first.
+const char kSnapshotMagic[8] = {'L', 'O', 'T', 'T', 'E', 'R', 'Y', 0};
+const uint32_t kSnapshotVersion = 2;
+const size_t kSnapshotAlign = 64;
+
+struct SnapshotHeader {
+  char magic[8];
+  uint32_t version;
+  uint32_t rng;
+  uint64_t size;
+  uint64_t count;
+  uint64_t first_stream;
+  uint64_t seed;
+  uint64_t jackpot_fund;
+  uint64_t fund;
+  uint64_t sell_count;
+  uint64_t count_winners;
+  uint64_t prize_count;
+  uint64_t round_count;
+  uint64_t nums_offset;
+  uint64_t purchased_offset;
+  uint64_t winners_offset;
+  uint64_t prizes_offset;
+  uint64_t rounds_offset;
+  uint8_t virtual_nums;
+  uint8_t engine;
+  uint8_t active;
+  uint8_t sold;
+  uint8_t missed_set;
+  uint8_t ruined_fund;
+  uint8_t has_jackpot;
+  // Ticket format; version 1 snapshots hold 6x5/90 tickets and zeros here
+  uint8_t rows;
+  uint8_t cols;
+  uint8_t max_num;
+  uint8_t reserved[5];
+};
+
+struct SnapshotRound {
+  uint64_t prize;
+  uint64_t winner_count;
+  uint8_t missed_numbers;
+  uint8_t ball_count;
+  uint8_t balls[kMaxBalls];
+};
+
+inline size_t snapshot_round_size(uint64_t winner_count) {
+  return sizeof(SnapshotRound) + (winner_count * sizeof(uint32_t) + 7) / 8 * 8;
+}
+
+// True if len bytes from offset end at or before limit; written so that a corrupt
+// offset or length can not wrap around
+inline bool snapshot_section_fits(uint64_t offset, uint64_t len, uint64_t limit) {
+  return offset <= limit && len <= limit - offset;
+}
+
+// Header of a mapped snapshot if it has a known version, holds tickets of format G and
+// all sections fit, or null
+template <typename G>
+const SnapshotHeader* snapshot_header(const MappedFile& file) {
+  if (!file.data() || file.size() < sizeof(SnapshotHeader))
+    return nullptr;
+
+  const SnapshotHeader* header = reinterpret_cast<const SnapshotHeader*>(file.data());
+  size_t words = (header->count + 63) / 64;
+
+  if (!std::equal(kSnapshotMagic, kSnapshotMagic + 8, header->magic) || !header->version || header->version > kSnapshotVersion || header->size != file.size())
+    return nullptr;
+
+  if (header->version == 1 ? !std::is_same<G, Lotto90>::value : header->rows != G::rows || header->cols != G::cols || header->max_num != G::max_num)
+    return nullptr;
+
+  if (!header->count || header->count > UINT32_MAX || header->rng > static_cast<uint32_t>(RngKind::kPhilox) || header->engine > static_cast<uint8_t>(DrawEngine::kEvent))
+    return nullptr;
+
+  // sell() never indexes virtual editions or more tickets than 32-bit postings address
+  if (header->engine == static_cast<uint8_t>(DrawEngine::kIndex) && (header->virtual_nums || header->count > UINT32_MAX / G::rows))
+    return nullptr;
+
+  if (header->prize_count > header->count)
+    return nullptr;
+
+  if ((!header->virtual_nums && !snapshot_section_fits(header->nums_offset, header->count * G::nums, header->purchased_offset)) ||
+      !snapshot_section_fits(header->purchased_offset, words * 8, header->winners_offset) || !snapshot_section_fits(header->winners_offset, words * 8, header->prizes_offset) ||
+      !snapshot_section_fits(header->prizes_offset, header->prize_count * 16, header->rounds_offset) || header->rounds_offset > header->size)
+    return nullptr;
+
+  // Prizes are looked up by binary search over ticket positions
+  const uint64_t* prizes = reinterpret_cast<const uint64_t*>(file.data() + header->prizes_offset);
+
+  for (size_t i = 0; i < header->prize_count; ++i) {
+    if (prizes[2 * i] >= header->count || (i && prizes[2 * i] <= prizes[2 * i - 2]))
+      return nullptr;
+  }
+
+  size_t offset = header->rounds_offset;
+
+  for (size_t i = 0; i < header->round_count; ++i) {
+    if (!snapshot_section_fits(offset, sizeof(SnapshotRound), header->size))
+      return nullptr;
+
+    const SnapshotRound* round = reinterpret_cast<const SnapshotRound*>(file.data() + offset);
+
+    if (round->ball_count > G::max_num || round->winner_count > header->count)
+      return nullptr;
+
+    if (!snapshot_section_fits(offset, snapshot_round_size(round->winner_count), header->size))
+      return nullptr;
+
+    offset += snapshot_round_size(round->winner_count);
+  }
+
+  return header;
+}
+
+// Prize rule of a round (from 0): either a fixed prize per winner or a total prize
+// shared by all winners; the other one is set to 0
+inline void round_prize(size_t round_number, size_t& prize, size_t& total_prize) {
+  ++round_number;
+
+  prize = 0;
+  total_prize = 0;
+
+  if (round_number == 1) {
+    total_prize = 500000;
+  } else if (round_number == 2) {
+    prize = 5000000;
+  } else if (round_number >= 3 && round_number <= 6) {
+    prize = 1000000;
+  } else if (round_number == 7) {
+    total_prize = 500000;
+  } else if (round_number >= 8 && round_number <= 12) {
+    prize = 10000;
+  } else if (round_number >= 13 && round_number <= 15) {
+    prize = 5000;
+  } else if (round_number >= 16 && round_number <= 18) {
+    prize = 1000;
+  } else if (round_number >= 19 && round_number <= 21) {
+    prize = 500;
+  } else if (round_number >= 22 && round_number <= 24) {
+    prize = 300;
+  } else if (round_number >= 25 && round_number <= 27) {
+    prize = 200;
+  } else {
+    prize = 100;
+  }
+}
+
+template <template <typename...> typename T, typename G = Lotto90>
+class Edition {
+public:
+  const size_t id;
+  const size_t min_id;
+  const size_t count;
+  const size_t jackpot_fund;
+  const uint64_t seed;
+
+  // Balls within which a half card wins the jackpot
+  static const size_t kJackpotCountSteps = G::half_rows * G::cols;
+  static const size_t kMaxCount = UINT32_MAX;
+  static const size_t kMaxIndexCount = UINT32_MAX / G::rows;
+
+  // Rounds are allocated from the edition's own arena and freed with the edition
+  Edition(size_t id, size_t count, size_t min_id, size_t jackpot_fund, uint64_t seed, RngKind rng, bool virtual_nums = false) : id(id), min_id(min_id), count(count), jackpot_fund(jackpot_fund), seed(seed), tickets_(count, min_id, seed, rng, virtual_nums) {
+    if (virtual_nums)
+      return;
+
+    std::string caption = "Generating ";
+    caption += std::to_string(count);
+    caption += " tickets";
+
+    PhaseTimer timer(Phase::kGenerate);
+
+    parallel_for(count, kGenerateBlock, caption, [this](size_t begin, size_t end, size_t) { tickets_.generate(begin, end); });
+    Stats::count(Counter::kTicketsGenerated, count);
+  }
+
+  // Reopens a snapshot (checked by snapshot_header) as edition id with tickets from
+  // min_id. Ticket numbers stay in the mapping, which the edition keeps open.
+  Edition(size_t id, size_t min_id, std::unique_ptr<MappedFile> file) : Edition(id, min_id, *snapshot_header<G>(*file)) {
+    file_ = std::move(file);
+
+    const unsigned char* data = file_->data();
+    const SnapshotHeader& header = *reinterpret_cast<const SnapshotHeader*>(data);
+
+    tickets_.restore(reinterpret_cast<const uint64_t*>(data + header.purchased_offset), reinterpret_cast<const uint64_t*>(data + header.winners_offset), reinterpret_cast<const uint64_t*>(data + header.prizes_offset), header.prize_count);
+
+    rounds_.reserve(header.round_count);
+
+    // Winner positions are used in place as well
+    for (size_t i = 0, offset = header.rounds_offset; i < header.round_count; ++i) {
+      const SnapshotRound& saved = *reinterpret_cast<const SnapshotRound*>(data + offset);
+      const uint32_t* winners = reinterpret_cast<const uint32_t*>(data + offset + sizeof(SnapshotRound));
+      Round* round = arena_.make<Round>(Balls(saved.balls, 0, saved.ball_count), WinnerIds(winners, saved.winner_count, min_id), saved.prize, saved.missed_numbers);
+
+      if (!i && header.has_jackpot)
+        jackpot_ = round;
+      else
+        add_round(round);
+
+      offset += snapshot_round_size(saved.winner_count);
+    }
+
+    engine_ = usable_engine(static_cast<DrawEngine>(header.engine), count, header.virtual_nums);
+    active_ = header.active;
+    sold_ = header.sold;
+    set_missed_already_ = header.missed_set;
+    fund_ = header.fund;
+    sell_count_ = header.sell_count;
+    count_winners_ = header.count_winners;
+    ruined_fund_ = header.ruined_fund;
+
+    if (sold_ && active_ && engine_ == DrawEngine::kIndex)
+      build_index();
+    else if (sold_ && active_ && engine_ == DrawEngine::kMask && !tickets_.is_virtual())
+      build_masks();
+  }
+
+  // Streams the edition to path in the snapshot format; false on write errors
+  bool save(const std::string& path) const {
+    const std::vector<uint64_t>& purchased = tickets_.purchased();
+    const std::vector<uint64_t>& winners = tickets_.winners();
+    const std::vector<std::pair<size_t, size_t>>& prizes = tickets_.prizes();
+
+    std::vector<const Round*> rounds;
+
+    if (jackpot_)
+      rounds.push_back(jackpot_);
+
+    for (size_t i = 0; i < rounds_.size(); ++i)
+      rounds.push_back(rounds_[i]);
+
+    auto align = [](size_t offset) { return (offset + kSnapshotAlign - 1) / kSnapshotAlign * kSnapshotAlign; };
+
+    SnapshotHeader header = {};
+    std::copy(kSnapshotMagic, kSnapshotMagic + 8, header.magic);
+    header.version = kSnapshotVersion;
+    header.rng = static_cast<uint32_t>(tickets_.rng());
+    header.count = count;
+    header.first_stream = tickets_.first_stream();
+    header.seed = seed;
+    header.jackpot_fund = jackpot_fund;
+    header.fund = fund_;
+    header.sell_count = sell_count_;
+    header.count_winners = count_winners_;
+    header.prize_count = prizes.size();
+    header.round_count = rounds.size();
+    header.nums_offset = align(sizeof(SnapshotHeader));
+    header.purchased_offset = align(header.nums_offset + (tickets_.is_virtual() ? 0 : count * G::nums));
+    header.winners_offset = align(header.purchased_offset + purchased.size() * 8);
+    header.prizes_offset = align(header.winners_offset + winners.size() * 8);
+    header.rounds_offset = align(header.prizes_offset + prizes.size() * 16);
+    header.size = header.rounds_offset;
+    header.virtual_nums = tickets_.is_virtual();
+    header.engine = static_cast<uint8_t>(engine_);
+    header.active = active_;
+    header.sold = sold_;
+    header.missed_set = set_missed_already_;
+    header.ruined_fund = ruined_fund_;
+    header.has_jackpot = jackpot_ != nullptr;
+    header.rows = G::rows;
+    header.cols = G::cols;
+    header.max_num = G::max_num;
+
+    for (size_t i = 0; i < rounds.size(); ++i)
+      header.size += snapshot_round_size(rounds[i]->winners.size());
+
+    std::vector<char> buffer(1 << 20);
+    std::ofstream file;
+    file.rdbuf()->pubsetbuf(buffer.data(), buffer.size());
+    file.open(path, std::ios::binary | std::ios::trunc);
+
+    size_t written = 0;
+
+    auto write = [&](const void* data, size_t size) {
+      file.write(static_cast<const char*>(data), size);
+      written += size;
+    };
+
+    auto pad = [&](size_t offset) {
+      const char zeros[kSnapshotAlign] = {};
+
+      while (written < offset)
+        write(zeros, std::min(offset - written, sizeof(zeros)));
+    };
+
+    write(&header, sizeof(header));
+    pad(header.nums_offset);
+
+    if (!tickets_.is_virtual())
+      write(tickets_.nums(0), count * G::nums);
+
+    pad(header.purchased_offset);
+    write(purchased.data(), purchased.size() * 8);
+    pad(header.winners_offset);
+    write(winners.data(), winners.size() * 8);
+    pad(header.prizes_offset);
+
+    for (size_t i = 0; i < prizes.size(); ++i) {
+      uint64_t pair[2] = {prizes[i].first, prizes[i].second};
+      write(pair, sizeof(pair));
+    }
+
+    pad(header.rounds_offset);
+
+    for (size_t i = 0; i < rounds.size(); ++i) {
+      SnapshotRound saved = {};
+      saved.prize = rounds[i]->prize;
+      saved.winner_count = rounds[i]->winners.size();
+      saved.missed_numbers = rounds[i]->missed_numbers;
+      saved.ball_count = static_cast<uint8_t>(rounds[i]->combination.size());
+
+      for (size_t j = 0; j < rounds[i]->combination.size(); ++j)
+        saved.balls[j] = rounds[i]->combination[j];
+
+      write(&saved, sizeof(saved));
+
+      for (size_t j = 0; j < saved.winner_count; ++j) {
+        uint32_t pos = static_cast<uint32_t>(rounds[i]->winners[j] - min_id);
+        write(&pos, sizeof(pos));
+      }
+
+      pad(written + (8 - written % 8) % 8);
+    }
+
+    file.close();
+
+    return !file.fail();
+  }
+
+  // Engine an edition of count tickets draws with. The index engine needs stored numbers
+  // and 32-bit postings. The event engine keeps 3 bytes per ticket and about 12 per sold
+  // one, which would undo the point of a virtual edition. Both fall back to the mask
+  // engine, which for virtual editions recomputes the sold tickets' numbers every ball.
+  static DrawEngine usable_engine(DrawEngine engine, size_t count, bool virtual_nums) {
+    if (engine == DrawEngine::kIndex && (count > kMaxIndexCount || virtual_nums))
+      return DrawEngine::kMask;
+
+    return engine == DrawEngine::kEvent && virtual_nums ? DrawEngine::kMask : engine;
+  }
+
+  bool sell(size_t sell_count, DrawEngine engine) {
+    if (sold_ || !active_)
+      return false;
+
+    sell_count_ = sell_count;
+    engine_ = usable_engine(engine, count, tickets_.is_virtual());
+
+    std::string caption = "Selling ";
+    caption += std::to_string(sell_count_);
+    caption += " tickets";
+
+    {
+      PhaseTimer timer(Phase::kSell);
+      Progress progress(sell_count_, caption);
+
+      // Floyd's sampling with the purchased bitvector as the set of chosen positions
+      for (size_t i = 0, j = count - sell_count_; i < sell_count_; ++i, ++j) {
+        size_t pos = rnd_below(j + 1);
+
+        tickets_.set_purchased(tickets_.is_purchased(pos) ? j : pos);
+        progress.set(i + 1);
+      }
+    }
+
+    sold_ = true;
+
+    // Every round of a play ends on a ball of its own, and the missed numbers follow
+    rounds_.reserve(G::max_num);
+
+    if (engine_ == DrawEngine::kIndex)
+      build_index();
+    else if (engine_ == DrawEngine::kMask && !tickets_.is_virtual())
+      build_masks();
+
+    return true;
+  }
+
+  // Takes the ball order of the coming play; the event engine buckets tickets by the
+  // ball completing their first row, half card and card in one pass
+  void prepare_draw(const unsigned char* balls) {
+    if (engine_ == DrawEngine::kEvent && active_ && sold_)
+      build_events(balls);
+  }
+
+  // Scans for tickets completing round `round_number` with the session's last ball and
+  // settles the round if any did or the ball is the last one
+  bool draw(DrawSession<G>& session, size_t round_number, size_t count_equal_nums, size_t& prize_fund, bool& ruined_fund) {
+    if (!active_)
+      return false;
+
+    size_t total_count_balls = session.size() - 1;
+    const std::string& caption = session.caption();
+    BlockBuffers<uint32_t>& buffers = session.winners();
+
+    {
+      PhaseTimer timer(Phase::kMatch);
+
+      if (engine_ == DrawEngine::kIndex)
+        match_index(session.back(), count_equal_nums, caption, buffers);
+      else if (engine_ == DrawEngine::kEvent)
+        match_events(count_equal_nums, total_count_balls, caption, buffers);
+      else
+        match_masks(session.drawn(), count_equal_nums, caption, buffers);
+    }
+
+    size_t count_winners = buffers.size();
+
+    if (count_winners || total_count_balls + 1 == G::max_num) {
+      PhaseTimer timer(Phase::kSettle);
+      size_t prize_round;
+
+      Stats::count(Counter::kWinnersEmitted, count_winners);
+      Stats::count(Counter::kRounds, 1);
+
+      if (total_count_balls != kJackpotCountSteps - 1 || round_number != 1) {
+        prize_round = allocation_fund(round_number, count_winners, prize_fund, ruined_fund);
+        ruined_fund_ = ruined_fund;
+      }
+      else
+        prize_round = jackpot_fund / count_winners;
+
+      // Winner positions are merged straight into the arena and kept by the round
+      uint32_t* winners = arena_.allocate<uint32_t>(count_winners);
+      buffers.merge(winners);
+      tickets_.set_winners(winners, count_winners, prize_round);
+
+      Round* round = arena_.make<Round>(session.round_balls(), WinnerIds(winners, count_winners, min_id), prize_round);
+
+      if (total_count_balls != kJackpotCountSteps - 1 || round_number != 1)
+        add_round(round);
+      else
+        jackpot_ = round;
+
+      count_winners_ += count_winners;
+
+      return true;
+    }
+
+    return false;
+  }
+
+  DrawEngine engine() const {
+    return engine_;
+  }
+
+  bool is_virtual() const {
+    return tickets_.is_virtual();
+  }
+
+  // Records the balls drawn since the last round as the missed numbers
+  bool set_missed_numbers(const DrawSession<G>& session) {
+    if (set_missed_already_ || !active_)
+      return false;
+
+    Round* missed = arena_.make<Round>(session.round_balls(), WinnerIds(nullptr, 0, min_id), 0, true);
+    Stats::count(Counter::kRounds, 1);
+    add_round(missed);
+
+    set_missed_already_ = true;
+
+    return true;
+  }
+
+  // Plays the shuffled balls under the game rules. Round r is won by G::round_nums(r)
+  // equal numbers; a jackpot is settled on its own and leaves the round open. Once the
+  // fund is ruined, or only the last ball is left, the remaining balls are the missed
+  // numbers. Calls on_round(round number) before the first scan of each round and
+  // on_settled(round number, round) for each round with winners, the jackpot and the
+  // missed numbers. Returns the number of scans.
+  template <typename RoundFunc, typename SettledFunc>
+  size_t play(const unsigned char* balls, size_t& prize_fund, RoundFunc on_round, SettledFunc on_settled) {
+    prepare_draw(balls);
+
+    DrawSession<G> session;
+    size_t round_number = 0;
+    size_t prev_round = 0;
+    size_t scans = 0;
+    bool jackpot_settled = false;
+    bool ruined_fund = false;
+
+    on_round(round_number);
+
+    for (size_t i = 0; i < G::max_num; ++i) {
+      session.push(balls[i]);
+
+      if (ruined_fund || i + 1 == G::max_num) {
+        if (i + 1 < G::max_num)
+          continue;
+
+        set_missed_numbers(session);
+        on_settled(round_number, round(round_number));
+        break;
+      }
+
+      if (round_number != prev_round) {
+        on_round(round_number);
+        prev_round = round_number;
+      }
+
+      ++scans;
+
+      if (!draw(session, round_number, G::round_nums(round_number), prize_fund, ruined_fund))
+        continue;
+
+      if (jackpot_ && !jackpot_settled) {
+        jackpot_settled = true;
+        on_settled(round_number, jackpot_);
+        continue;
+      }
+
+      on_settled(round_number, round(round_number));
+      session.close_round();
+      ++round_number;
+    }
+
+    return scans;
+  }
+
+  Ticket<G> ticket(size_t pos) const {
+    return Ticket<G>(tickets_, pos, min_id + pos);
+  }
+
+  Round* round(size_t pos) const {
+    return rounds_[pos];
+  }
+
+  size_t round_count() const {
+    return rounds_.size();
+  }
+
+  // Numbers of the rounds with winners and a prize in [min, max], in round order
+  std::vector<size_t> rounds_with_prize(size_t min, size_t max) const {
+    auto first = std::lower_bound(prize_index_.begin(), prize_index_.end(), std::make_pair(min, size_t(0)));
+    auto last = std::upper_bound(first, prize_index_.end(), std::make_pair(max, SIZE_MAX));
+    std::vector<size_t> result;
+
+    for (; first != last; ++first)
+      result.push_back(first->second);
+
+    std::sort(result.begin(), result.end());
+
+    return result;
+  }
+
+  Round* jackpot() const {
+    return jackpot_;
+  }
+
+  bool is_active() const {
+    return active_;
+  }
+
+  void disable() {
+    active_ = false;
+  }
+
+  bool is_sold() const {
+    return sold_;
+  }
+
+  size_t fund() const {
+    return fund_;
+  }
+
+  bool set_fund(size_t fund) {
+    if (!active_ || !sold_)
+      return false;
+
+    fund_ = fund;
+
+    return true;
+  }
+
+  size_t sell_count() const {
+    return sell_count_;
+  }
+
+  size_t count_winners() const {
+    return count_winners_;
+  }
+
+  bool ruined_fund() const {
+    return ruined_fund_;
+  }
+
+  bool is_released() const {
+    return tickets_.is_released();
+  }
+
+  // Calls func(position, prize) for every purchased ticket in ascending order
+  template <typename Func>
+  void for_each_purchased(Func func) const {
+    const std::vector<uint64_t>& purchased = tickets_.purchased();
+    const std::vector<std::pair<size_t, size_t>>& prizes = tickets_.prizes();
+    size_t next = 0;
+
+    for (size_t i = 0; i < purchased.size(); ++i) {
+      for (uint64_t bits = purchased[i]; bits; bits &= bits - 1) {
+        size_t pos = i * 64 + __builtin_ctzll(bits);
+
+        while (next < prizes.size() && prizes[next].first < pos)
+          ++next;
+
+        func(pos, next < prizes.size() && prizes[next].first == pos ? prizes[next].second : 0);
+      }
+    }
+  }
+
+  // Frees ticket numbers and draw structures of a played edition, keeping its
+  // rounds and totals; the edition's tickets must not be viewed afterwards
+  void release_tickets() {
+    tickets_.release();
+    row_hits_ = std::vector<unsigned char>();
+    masks_ = std::vector<BallMask>();
+    mask_pos_ = std::vector<size_t>();
+    events_ = std::vector<uint32_t>();
+
+    for (size_t i = 0; i < G::max_num; ++i)
+      index_[i] = Interlayer<uint32_t, T<uint32_t>>();
+  }
+
+private:
+  TicketStore<G> tickets_;
+  Arena arena_;
+  std::unique_ptr<MappedFile> file_;
+  Interlayer<Round*, T<Round*>> rounds_;
+  Round* jackpot_ = nullptr;
+
+  // (prize, round number) of rounds with winners, ascending
+  std::vector<std::pair<size_t, size_t>> prize_index_;
+
+  // Ball number -> ascending (ticket position * rows + row) of purchased tickets holding it
+  Interlayer<uint32_t, T<uint32_t>> index_[G::max_num];
+  std::vector<unsigned char> row_hits_;
+
+  // Row masks of purchased tickets, G::rows per entry of mask_pos_ (empty for virtual editions)
+  std::vector<BallMask> masks_;
+  std::vector<size_t> mask_pos_;
+
+  static constexpr size_t kMaskBlock = 256;
+  static const size_t kEventKinds = 3;
+  static const size_t kGenerateBlock = 1 << 16;
+  static const size_t kDrawBlock = 1 << 14;
+
+  // Positions of purchased tickets by (kind, ball index) of their first completed row,
+  // half card and card, ascending within a bucket; bucket b spans
+  // [event_offsets_[b], event_offsets_[b + 1])
+  std::vector<uint32_t> events_;
+  size_t event_offsets_[kEventKinds * G::max_num + 1];
+
+  DrawEngine engine_ = DrawEngine::kIndex;
+
+  bool active_ = true;
+  bool sold_ = false;
+  bool set_missed_already_ = false;
+
+  size_t fund_ = 0;
+  size_t sell_count_ = 0;
+  size_t count_winners_ = 0;
+  bool ruined_fund_ = false;
+
+  Edition(size_t id, size_t min_id, const SnapshotHeader& header) : id(id), min_id(min_id), count(header.count), jackpot_fund(header.jackpot_fund), seed(header.seed), tickets_(header.count, header.first_stream, header.seed, static_cast<RngKind>(header.rng), header.virtual_nums, header.virtual_nums ? nullptr : reinterpret_cast<const unsigned char*>(&header) + header.nums_offset) {}
+
+  void add_round(Round* round) {
+    rounds_.push(round);
+
+    if (round->winners.size()) {
+      std::pair<size_t, size_t> entry(round->prize, rounds_.size() - 1);
+      prize_index_.insert(std::upper_bound(prize_index_.begin(), prize_index_.end(), entry), entry);
+    }
+  }
+
+  void build_index() {
+    std::string caption = "Indexing ";
+    caption += std::to_string(sell_count_);
+    caption += " tickets";
+
+    row_hits_.assign(count * G::rows, 0);
+
+    PhaseTimer timer(Phase::kIndex);
+
+    // Exact posting counts first, only for policies that take size hints
+    if (Interlayer<uint32_t, T<uint32_t>>::kTakesHints) {
+      size_t postings[G::max_num] = {};
+
+      for (size_t i = 0; i < count; ++i) {
+        if (tickets_.is_purchased(i)) {
+          const unsigned char* nums = tickets_.nums(i);
+
+          for (size_t j = 0; j < G::nums; ++j)
+            ++postings[nums[j] - 1];
+        }
+      }
+
+      for (size_t i = 0; i < G::max_num; ++i)
+        index_[i].reserve(postings[i]);
+    }
+
+    Progress progress(count, caption);
+
+    for (size_t i = 0; i < count; ++i) {
+      if (tickets_.is_purchased(i)) {
+        const unsigned char* nums = tickets_.nums(i);
+
+        for (size_t j = 0; j < G::nums; ++j)
+          index_[nums[j] - 1].push(i * G::rows + j / G::cols);
+      }
+
+      progress.set(i + 1);
+    }
+  }
+
+  void build_masks() {
+    std::string caption = "Packing ";
+    caption += std::to_string(sell_count_);
+    caption += " tickets";
+
+    masks_.reserve(sell_count_ * G::rows);
+    mask_pos_.reserve(sell_count_);
+
+    PhaseTimer timer(Phase::kIndex);
+    Progress progress(count, caption);
+
+    for (size_t i = 0; i < count; ++i) {
+      if (tickets_.is_purchased(i)) {
+        masks_.resize(masks_.size() + G::rows);
+        pack_rows<G>(tickets_.nums(i), &masks_[masks_.size() - G::rows]);
+        mask_pos_.push_back(i);
+      }
+
+      progress.set(i + 1);
+    }
+  }
+
+  void build_events(const unsigned char* balls) {
+    unsigned char rank[G::max_num];
+
+    for (size_t i = 0; i < G::max_num; ++i)
+      rank[balls[i] - 1] = static_cast<unsigned char>(i);
+
+    std::string caption = "Ranking ";
+    caption += std::to_string(sell_count_);
+    caption += " tickets";
+
+    // Completion indices per ticket (unsold ones left at kUnsold), then per block bucket
+    // sizes, turned into each block's first slot of every bucket
+    const unsigned char kUnsold = 0xFF;
+    const size_t buckets = kEventKinds * G::max_num;
+    size_t blocks = (count + kDrawBlock - 1) / kDrawBlock;
+    std::vector<unsigned char> done(count * kEventKinds, kUnsold);
+    std::vector<size_t> slots(blocks * buckets);
+
+    PhaseTimer timer(Phase::kRank);
+
+    parallel_for(count, kDrawBlock, caption, [&](size_t begin, size_t end, size_t) {
+      size_t* sizes = &slots[begin / kDrawBlock * buckets];
+      unsigned char nums[G::nums];
+      size_t ranked = 0;
+
+      for (size_t pos = begin; pos < end; ++pos) {
+        if (!tickets_.is_purchased(pos))
+          continue;
+
+        ++ranked;
+
+        const unsigned char* ticket = tickets_.is_virtual() ? nums : tickets_.nums(pos);
+        unsigned char rows[G::rows];
+
+        if (tickets_.is_virtual())
+          tickets_.load_nums(pos, nums);
+
+        for (size_t r = 0; r < G::rows; ++r) {
+          rows[r] = 0;
+
+          for (size_t c = 0; c < G::cols; ++c)
+            rows[r] = std::max(rows[r], rank[ticket[r * G::cols + c] - 1]);
+        }
+
+        unsigned char* indices = &done[pos * kEventKinds];
+
+        indices[0] = *std::min_element(rows, rows + G::rows);
+        indices[1] = kUnsold;
+        indices[2] = *std::max_element(rows, rows + G::rows);
+
+        for (size_t r = 0; r < G::rows; r += G::half_rows)
+          indices[1] = std::min(indices[1], *std::max_element(rows + r, rows + r + G::half_rows));
+
+        for (size_t kind = 0; kind < kEventKinds; ++kind)
+          ++sizes[kind * G::max_num + indices[kind]];
+      }
+
+      Stats::count(Counter::kTicketsScanned, ranked);
+      Stats::count(Counter::kNumbersProbed, ranked * G::nums);
+    }, true);
+
+    size_t total = 0;
+
+    for (size_t bucket = 0; bucket < buckets; ++bucket) {
+      event_offsets_[bucket] = total;
+
+      for (size_t block = 0; block < blocks; ++block) {
+        size_t size = slots[block * buckets + bucket];
+
+        slots[block * buckets + bucket] = total;
+        total += size;
+      }
+    }
+
+    event_offsets_[buckets] = total;
+    events_.resize(total);
+
+    parallel_for(count, kDrawBlock, caption, [&](size_t begin, size_t end, size_t) {
+      size_t* next = &slots[begin / kDrawBlock * buckets];
+
+      for (size_t pos = begin; pos < end; ++pos) {
+        const unsigned char* indices = &done[pos * kEventKinds];
+
+        if (indices[0] == kUnsold)
+          continue;
+
+        for (size_t kind = 0; kind < kEventKinds; ++kind)
+          events_[next[kind * G::max_num + indices[kind]]++] = static_cast<uint32_t>(pos);
+      }
+    }, true);
+  }
+
+  // Tickets completing the round's segment on ball `ball_index` are exactly those in its
+  // bucket: a ticket that completed one earlier would have won an earlier round
+  void match_events(size_t count_equal_nums, size_t ball_index, const std::string& caption, BlockBuffers<uint32_t>& buffers) {
+    size_t kind = count_equal_nums == G::cols ? 0 : count_equal_nums < G::nums ? 1 : 2;
+    size_t first = event_offsets_[kind * G::max_num + ball_index];
+    size_t size = event_offsets_[kind * G::max_num + ball_index + 1] - first;
+
+    parallel_for(size, kDrawBlock, caption, [&](size_t begin, size_t end, size_t worker) {
+      for (size_t i = begin; i < end; ++i) {
+        if (!tickets_.is_winner(events_[first + i]))
+          buffers.push(worker, begin, events_[first + i]);
+      }
+
+      Stats::count(Counter::kTicketsScanned, end - begin);
+    }, true);
+  }
+
+  void match_index(unsigned char ball, size_t count_equal_nums, const std::string& caption, BlockBuffers<uint32_t>& buffers) {
+    const Interlayer<uint32_t, T<uint32_t>>& postings = index_[ball - 1];
+    size_t segment_rows = count_equal_nums / G::cols;
+
+    parallel_for(postings.size(), kDrawBlock, caption, [&](size_t begin, size_t end, size_t worker) {
+      size_t probed = 0;
+
+      for (size_t i = begin; i < end; ++i) {
+        size_t pos = postings[i] / G::rows;
+
+        if (tickets_.is_winner(pos))
+          continue;
+
+        // One counter bump plus the row counters of its segment
+        probed += segment_rows + 1;
+        ++row_hits_[postings[i]];
+
+        size_t first = pos * G::rows + postings[i] % G::rows / segment_rows * segment_rows;
+        size_t hits = 0;
+
+        for (size_t k = 0; k < segment_rows; ++k)
+          hits += row_hits_[first + k];
+
+        if (hits == count_equal_nums)
+          buffers.push(worker, begin, pos);
+      }
+
+      Stats::count(Counter::kTicketsScanned, end - begin);
+      Stats::count(Counter::kNumbersProbed, probed);
+    }, true);
+  }
+
+  void match_masks(const BallMask& drawn, size_t count_equal_nums, const std::string& caption, BlockBuffers<uint32_t>& buffers) {
+    size_t segment_rows = count_equal_nums / G::cols;
+    unsigned segment = (1u << segment_rows) - 1;
+
+    auto match = [&](const BallMask* rows, const size_t* positions, size_t block, size_t begin, size_t worker) {
+      unsigned char complete[kMaskBlock];
+
+      match_rows<G>(rows, block, drawn, complete);
+      Stats::count(Counter::kTicketsScanned, block);
+      Stats::count(Counter::kNumbersProbed, block * G::nums);
+
+      for (size_t i = 0; i < block; ++i) {
+        if (!complete[i] || tickets_.is_winner(positions[i]))
+          continue;
+
+        for (size_t r = 0; r < G::rows; r += segment_rows) {
+          if ((complete[i] >> r & segment) == segment) {
+            buffers.push(worker, begin, positions[i]);
+            break;
+          }
+        }
+      }
+    };
+
+    if (!tickets_.is_virtual()) {
+      parallel_for(mask_pos_.size(), kDrawBlock, caption, [&](size_t begin, size_t end, size_t worker) {
+        for (size_t first = begin; first < end; first += kMaskBlock)
+          match(&masks_[first * G::rows], &mask_pos_[first], std::min(kMaskBlock, end - first), begin, worker);
+      }, true);
+    } else {
+      parallel_for(count, kDrawBlock, caption, [&](size_t begin, size_t end, size_t worker) {
+        BallMask rows[kMaskBlock * G::rows];
+        size_t positions[kMaskBlock];
+        unsigned char nums[G::nums];
+        size_t block = 0;
+
+        for (size_t pos = begin; pos < end; ++pos) {
+          if (!tickets_.is_purchased(pos) || tickets_.is_winner(pos))
+            continue;
+
+          tickets_.load_nums(pos, nums);
+          pack_rows<G>(nums, &rows[block * G::rows]);
+          positions[block++] = pos;
+
+          if (block == kMaskBlock) {
+            match(rows, positions, block, begin, worker);
+            block = 0;
+          }
+        }
+
+        match(rows, positions, block, begin, worker);
+      }, true);
+    }
+  }
+
+  size_t allocation_fund(size_t round_number, size_t count_winners, size_t& prize_fund, bool& ruined_fund) const {
+    size_t prize;
+    size_t total_prize;
+
+    round_prize(round_number, prize, total_prize);
+
+    if (prize_fund / count_winners < prize || total_prize && prize_fund < total_prize) {
+      prize = prize_fund / count_winners;
+      total_prize = prize * count_winners;
+
+      ruined_fund = true;
+    }
+
+    if (prize && !total_prize)
+      total_prize = prize * count_winners;
+    else if (total_prize && !prize)
+      prize = total_prize / count_winners;
+
+    if (prize_fund <= total_prize)
+      prize_fund = 0;
+    else
+      prize_fund -= total_prize;
+
+    return prize;
+  }
+};
+
+enum class ExportFormat {
+  kCsv,
+  kNdjson,
+  kBinary
+};
+
+// Columnar export: ExportHeader, then 8-byte aligned columns: rounds (edition u32,
+// round u32, kind u8, prize u64, ball count u8, balls u8[90], first winner u64 with
+// one extra entry for the end), winner ticket IDs u64, and purchased tickets (ID u64,
+// prize u64)
+const char kExportMagic[8] = {'L', 'O', 'T', 'T', 'E', 'X', 'P', 0};
+const uint32_t kExportVersion = 1;
+
+struct ExportHeader {
+  char magic[8];
+  uint32_t version;
+  uint32_t reserved;
+  uint64_t round_count;
+  uint64_t winner_count;
+  uint64_t ticket_count;
+};
+
+template <template <typename...> typename T, typename G = Lotto90>
+class Game {
+public:
+  static constexpr double kPercentagePrizeFund = 0.5;
+
+  Game(std::ostream& out = std::cout) : out_(out), page_(out) {}
+
+  ~Game() {
+    if (!last_edit_)
+      return;
+
+    for (size_t i = 0; i <= last_edit_id_; ++i)
+      delete editions_[i];
+  }
+
+  void add() {
+    size_t count = sub_cmd<size_t>("Number of tickets in new edition");
+    size_t jackpot_add = 0;
+    bool add_balance = false;
+    bool simulate_jackpot = false;
+    bool virtual_nums = false;
+
+    if (count) {
+      jackpot_add = sub_cmd<size_t>("Add to jackpot fund");
+      add_balance = sub_cmd<bool>("Add last fund balance to jackpot fund", false, true);
+      simulate_jackpot = sub_cmd<bool>("Simulate jackpot", false, true);
+      virtual_nums = sub_cmd<bool>("Virtual edition (numbers recomputed on demand)", true, true);
+    }
+
+    add(count, jackpot_add, add_balance, simulate_jackpot, virtual_nums);
+  }
+
+  bool add(size_t count, size_t jackpot_add, bool add_balance, bool simulate_jackpot, bool virtual_nums) {
+    if (last_edit_)
+      last_edit_->disable();
+
+    if (!count) {
+      out_ << "Number of tickets can only be positive" << std::endl;
+      return false;
+    }
+
+    if (count > Edition<T, G>::kMaxCount) {
+      out_ << "Number of tickets can not exceed " << Edition<T, G>::kMaxCount << std::endl;
+      return false;
+    }
+
+    jackpot_fund_ += jackpot_add;
+
+    if (add_balance) {
+      jackpot_fund_ += last_fund_balance_;
+      last_fund_balance_ = 0;
+    }
+
+    simulate_jackpot_ = simulate_jackpot;
+
+    Edition<T, G>* edition = new Edition<T, G>(++last_edit_id_, count, count_, jackpot_fund_, rnd_gen(), RNG, virtual_nums);
+    editions_.push(edition);
+    min_ids_.push_back(count_);
+
+    last_edit_ = editions_[last_edit_id_];
+    count_ += count;
+
+    out_ << "Jackpot fund: " << last_edit_->jackpot_fund << std::endl;
+
+    return true;
+  }
+
+  void sell() {
+    if (check_sell())
+      sell(sub_cmd<double>("Percentage of tickets will be sold", true));
+  }
+
+  bool sell(double percentage) {
+    if (!check_sell())
+      return false;
+
+    if (percentage <= 0.0 || percentage > 100.0) {
+      out_ << "Percentage can only be in the range (0, 100]" << std::endl;
+      return false;
+    }
+
+    size_t sell_count = percentage * last_edit_->count / 100;
+
+    if (!sell_count)
+      sell_count = 1;
+
+    if (!last_edit_->sell(sell_count, draw_engine_))
+      return false;
+
+    size_t fund = kPercentagePrizeFund * Ticket<G>::price * sell_count;
+
+    if (!last_edit_->set_fund(fund)) {
+      out_ << "Fund setting error" << std::endl;
+      return false;
+    }
+
+    out_ << "Prize fund: " << fund << std::endl;
+
+    return true;
+  }
+
+  bool play() {
+    if (!last_edit_) {
+      out_ << "Last edition does not exist" << std::endl;
+      return false;
+    }
+
+    if (!last_edit_->is_active()) {
+      out_ << "Last edition was disabled" << std::endl;
+      return false;
+    }
+
+    if (!last_edit_->is_sold()) {
+      out_ << "Last edition was not sold" << std::endl;
+      return false;
+    }
+
+    PhaseTimer timer(Phase::kPlay);
+    unsigned char balls[G::max_num];
+
+    for (size_t i = 0; i < G::max_num; ++i)
+      balls[i] = i + 1;
+
+    shuffle<unsigned char>(balls, G::max_num);
+
+    if (simulate_jackpot_) {
+      size_t rnd_ticket = rnd_below(last_edit_->count);
+
+      while (!last_edit_->ticket(rnd_ticket).is_purchased())
+        rnd_ticket = (rnd_ticket + 1) % last_edit_->count;
+
+      Ticket<G> ticket = last_edit_->ticket(rnd_ticket);
+
+      for (size_t i = 0; i < Edition<T, G>::kJackpotCountSteps; ++i) {
+        for (size_t j = i + 1; j < G::max_num; ++j) {
+          if (balls[j] == ticket.num(i))
+            std::swap(balls[i], balls[j]);
+        }
+      }
+
+      shuffle<unsigned char>(balls, Edition<T, G>::kJackpotCountSteps);
+    }
+
+    last_fund_balance_ = last_edit_->fund();
+
+    // Start of the round being drawn, for its trace span
+    Stats::Clock::time_point round_start = Stats::Clock::now();
+
+    auto on_round = [&](size_t round_number) {
+      out_ << "Round " << (round_number + 1) << std::endl;
+    };
+
+    auto on_settled = [&](size_t round_number, Round* round) {
+      std::string label;
+
+      if (round->missed_numbers) {
+        label = "Missed numbers";
+        out_ << "Missed numbers" << std::endl;
+      } else if (round == last_edit_->jackpot()) {
+        label = "Jackpot";
+        jackpot_fund_ = 0;
+        jackpot_editions_.push_back(last_edit_id_);
+
+        out_ << "Jackpot!" << std::endl;
+      } else {
+        label = "Round " + std::to_string(round_number + 1);
+      }
+
+      show_round(round);
+      page_.flush();
+
+      out_ << std::endl;
+
+      Stats::Clock::time_point round_end = Stats::Clock::now();
+      Stats::span(label, round_start, round_end);
+      round_start = round_end;
+    };
+
+    last_edit_->play(balls, last_fund_balance_, on_round, on_settled);
+
+    out_ << "Game over!" << std::endl;
+    out_ << "  Participated tickets: " << last_edit_->sell_count() << std::endl;
+    out_ << "  Total winners: " << last_edit_->count_winners() << std::endl;
+    out_ << "  Fund balance: " << last_fund_balance_ << std::endl;
+
+    last_edit_->disable();
+
+    return true;
+  }
+
+  void show() {
+    switch (sub_cmd<size_t>("Ticket[1], edition[2] or any to exit")) {
+    case 1: {
+      show_ticket(sub_cmd<size_t>("Ticket ID", true));
+      page_.flush();
+      break;
+    }
+    case 2: {
+      show_edition(sub_cmd<size_t>("Edition ID", true));
+      page_.flush();
+      break;
+    }
+    }
+  }
+
+  void show_round(Round* round) const {
+    const size_t kMaxCountShowingIds = 10;
+    PhaseTimer timer(Phase::kShow);
+
+    page_ << "  Combination: ";
+
+    if (!round->combination.size())
+      page_ << "(empty)";
+
+    for (size_t i = 0; i < round->combination.size(); ++i)
+      page_ << (i ? ", " : "") << (round->combination[i] < 10 ? "0" : "") << static_cast<int>(round->combination[i]);
+
+    page_ << '\n';
+
+    if (round->missed_numbers)
+      return;
+
+    page_ << "  " << round->winners.size() << " winners: ";
+
+    if (!round->winners.size())
+      page_ << "(empty)";
+
+    for (size_t i = 0; i < round->winners.size(); ++i) {
+      page_ << (i ? ", " : "") << round->winners[i];
+
+      if (i == kMaxCountShowingIds - 1) {
+        page_ << ", ...";
+        break;
+      }
+    }
+
+    page_ << '\n';
+
+    page_ << "  Prize: " << round->prize << '\n';
+  }
+
+  void show_ticket(size_t id) const {
+    if (!last_edit_) {
+      page_ << "No tickets at all" << '\n';
+      return;
+    }
+
+    size_t edit_id = find_edition(id);
+
+    if (edit_id > last_edit_id_) {
+      page_ << "Ticket not found" << '\n';
+      return;
+    }
+
+    Ticket<G> ticket = editions_[edit_id]->ticket(id - editions_[edit_id]->min_id);
+
+    // Details go right of the rows; formats with fewer rows than details get blank rows
+    const size_t kDetails = 5;
+
+    for (size_t r = 0; r < std::max(G::rows, kDetails); ++r) {
+      for (size_t c = 0; c < G::cols; ++c) {
+        if (r < G::rows)
+          page_ << (c ? " | " : "") << (ticket.num(r * G::cols + c) < 10 ? "0" : "") << static_cast<int>(ticket.num(r * G::cols + c));
+        else
+          page_ << (c ? "   " : "") << "  ";
+      }
+
+      page_ << "  :  ";
+
+      if (r == 0)
+        page_ << "ID: " << ticket.id;
+      else if (r == 1)
+        page_ << "Edition: " << edit_id << " (" << (editions_[edit_id]->is_active() ? "active, " : "not active, ") << (editions_[edit_id]->is_sold() ? "sold" : "not sold") << ")";
+      else if (r == 2)
+        page_ << "Purchased: " << (ticket.is_purchased() ? "yes" : "no");
+      else if (r == 3)
+        page_ << "Winner: " << (ticket.is_winner() ? "yes" : "no");
+      else if (r == 4)
+        page_ << "Prize: " << ticket.prize();
+
+      page_ << '\n';
+    }
+  }
+
+  void show_edition(size_t id) const {
+    if (!last_edit_) {
+      page_ << "No editions at all" << '\n';
+      return;
+    }
+
+    if (id > last_edit_id_) {
+      page_ << "Edition not found" << '\n';
+      return;
+    }
+
+    Edition<T, G>* edit = editions_[id];
+
+    page_ << "ID: " << id << " (" << (edit->is_active() ? "active, " : "not active, ") << (edit->is_sold() ? "sold" : "not sold") << ")" << '\n';
+    page_ << "Ticket IDs: " << edit->min_id << " to " << (edit->min_id + edit->count - 1) << '\n';
+    page_ << "Number of tickets: " << edit->count << (edit->is_virtual() ? " (virtual)" : "") << '\n';
+    page_ << "Participated tickets: " << edit->sell_count() << '\n';
+    page_ << "Total winners: " << edit->count_winners() << '\n';
+    page_ << "Prize fund: " << edit->fund() << '\n';
+    page_ << "Jackpot fund: " << edit->jackpot_fund << " (" << (edit->jackpot() ? "spent" : "unspent") << ")" << '\n';
+
+    if (edit->jackpot()) {
+      page_ << '\n';
+      page_ << "Jackpot" << '\n';
+      show_round(edit->jackpot());
+    }
+
+    for (size_t i = 0; i < edit->round_count(); ++i) {
+      page_ << '\n';
+
+      if (!edit->round(i)->missed_numbers)
+        page_ << "Round " << (i + 1) << '\n';
+      else
+        page_ << "Missed numbers" << '\n';
+
+      show_round(edit->round(i));
+    }
+  }
+
+  // (ticket ID, prize) pairs
+  using SearchResults = Interlayer<std::pair<size_t, size_t>, T<std::pair<size_t, size_t>>>;
+
+  // Appends winners of rounds with prizes in [min, max] of editions [edit_id, end_id_edit)
+  void find_prizes(size_t edit_id, size_t end_id_edit, size_t min, size_t max, SearchResults& list) const {
+    std::vector<const Round*> rounds;
+    size_t found = list.size();
+
+    for (size_t i = edit_id; i < end_id_edit; ++i) {
+      std::vector<size_t> numbers = editions_[i]->rounds_with_prize(min, max);
+
+      for (size_t j = 0; j < numbers.size(); ++j) {
+        rounds.push_back(editions_[i]->round(numbers[j]));
+        found += rounds.back()->winners.size();
+      }
+    }
+
+    list.reserve(found);
+
+    for (size_t j = 0; j < rounds.size(); ++j) {
+      for (size_t k = 0; k < rounds[j]->winners.size(); ++k)
+        list.push(std::make_pair(rounds[j]->winners[k], rounds[j]->prize));
+    }
+  }
+
+  // Appends jackpot winners of editions [edit_id, end_id_edit)
+  void find_jackpots(size_t edit_id, size_t end_id_edit, SearchResults& list) const {
+    auto first = std::lower_bound(jackpot_editions_.begin(), jackpot_editions_.end(), edit_id);
+    auto last = std::lower_bound(first, jackpot_editions_.end(), end_id_edit);
+    size_t found = list.size();
+
+    for (auto it = first; it != last; ++it)
+      found += editions_[*it]->jackpot()->winners.size();
+
+    list.reserve(found);
+
+    for (; first != last; ++first) {
+      const Round* jackpot = editions_[*first]->jackpot();
+
+      for (size_t j = 0; j < jackpot->winners.size(); ++j)
+        list.push(std::make_pair(jackpot->winners[j], jackpot->prize));
+    }
+  }
+
+  void search() const {
+    if (!last_edit_) {
+      out_ << "No tickets at all" << std::endl;
+      return;
+    }
+
+    size_t type_editions = sub_cmd<size_t>("Search in each[1] or specific[2] edition or any to exit");
+    size_t edit_id = 0;
+    size_t end_id_edit = 0;
+
+    if (type_editions == 1)
+      end_id_edit = last_edit_id_ + 1;
+    else if (type_editions == 2) {
+      while ((edit_id = sub_cmd<size_t>("Edition ID")) > last_edit_id_)
+        out_ << "Edition not found" << std::endl;
+
+      end_id_edit = edit_id + 1;
+    }
+
+    if (!end_id_edit)
+      return;
+
+    size_t type_search = sub_cmd<size_t>("Prizes[1], jackpots[2] or any to exit");
+    SearchResults list;
+
+    if (type_search == 1) {
+      size_t min = sub_cmd<size_t>("Min prize");
+      size_t max;
+
+      while ((max = sub_cmd<size_t>("Max prize")) < min)
+        out_ << "Max prize >= min prize" << std::endl;
+
+      find_prizes(edit_id, end_id_edit, min, max, list);
+    } else if (type_search == 2)
+      find_jackpots(edit_id, end_id_edit, list);
+    else
+      return;
+
+    if (!list.size()) {
+      out_ << std::endl;
+      out_ << "Empty result" << std::endl;
+      return;
+    } else if (list.size() > 1) {
+      switch (sub_cmd<size_t>("Sort results by ID[1], by prize[2] or any without sorting")) {
+      case 1:
+        list.sort([](const std::pair<size_t, size_t>& a, const std::pair<size_t, size_t>& b) { return a.first < b.first; });
+        break;
+      case 2:
+        list.sort([](const std::pair<size_t, size_t>& a, const std::pair<size_t, size_t>& b) { return (a.second > b.second) || (a.second == b.second && a.first < b.first); });
+        break;
+      }
+    }
+
+    out_ << std::endl;
+    out_ << "Found " << list.size() << " tickets" << std::endl;
+    out_ << std::endl;
+    size_t start = sub_cmd<size_t>("Show results from number");
+    size_t count = sub_cmd<size_t>("Show as many results (0 to exit)");
+
+    while (true) {
+      if (!count)
+        return;
+
+      if (start > list.size() - 1)
+        start = list.size() - 1;
+
+      if (start + count > list.size())
+        count = list.size() - start;
+
+      // The whole page is formatted first and written at once
+      page_ << '\n';
+      page_ << count << " results starting from number " << start << '\n';
+      page_ << '\n';
+
+      for (size_t i = start; i < start + count; ++i) {
+        show_ticket(list[i].first);
+        page_ << '\n';
+      }
+
+      page_.flush();
+
+      start = sub_cmd<size_t>("Show results from number");
+      count = sub_cmd<size_t>("Show as many results (0 to exit)");
+    }
+  }
+
+  void export_results() {
+    if (!last_edit_) {
+      out_ << "No editions at all" << std::endl;
+      return;
+    }
+
+    size_t type_editions = sub_cmd<size_t>("Export each[1] or specific[2] edition or any to exit");
+    size_t edit_id = 0;
+    size_t end_id_edit = 0;
+
+    if (type_editions == 1)
+      end_id_edit = last_edit_id_ + 1;
+    else if (type_editions == 2) {
+      while ((edit_id = sub_cmd<size_t>("Edition ID")) > last_edit_id_)
+        out_ << "Edition not found" << std::endl;
+
+      end_id_edit = edit_id + 1;
+    }
+
+    if (!end_id_edit)
+      return;
+
+    size_t format = sub_cmd<size_t>("CSV[1], NDJSON[2], columnar binary[3] or any to exit");
+
+    if (format < 1 || format > 3)
+      return;
+
+    export_results(static_cast<ExportFormat>(format - 1), sub_cmd<std::string>("File", true), edit_id, end_id_edit);
+  }
+
+  // Streams every round (combination, winner IDs, prize) of editions [first, end) and
+  // the outcome of each of their purchased tickets; editions whose tickets were
+  // released contribute rounds only
+  bool export_results(ExportFormat format, const std::string& path, size_t first, size_t end) {
+    if (!last_edit_ || first >= end || end > last_edit_id_ + 1) {
+      out_ << "Edition not found" << std::endl;
+      return false;
+    }
+
+    PhaseTimer timer(Phase::kExport);
+    OutputFile file(path);
+
+    if (!file.is_open()) {
+      out_ << "Cannot write " << path << std::endl;
+      return false;
+    }
+
+    size_t rounds = 0;
+    size_t winners = 0;
+    size_t tickets = 0;
+
+    for_each_round(first, end, [&](size_t, size_t, size_t, const Round* round) {
+      ++rounds;
+      winners += round->winners.size();
+    });
+
+    for (size_t i = first; i < end; ++i)
+      tickets += editions_[i]->is_released() ? 0 : editions_[i]->sell_count();
+
+    if (format == ExportFormat::kCsv)
+      export_csv(file, first, end);
+    else if (format == ExportFormat::kNdjson)
+      export_ndjson(file, first, end);
+    else
+      export_binary(file, first, end, rounds, winners, tickets);
+
+    if (!file.close()) {
+      out_ << "Cannot write " << path << std::endl;
+      return false;
+    }
+
+    out_ << "Exported " << rounds << " rounds, " << winners << " winners and " << tickets << " tickets to " << path << std::endl;
+
+    return true;
+  }
+
+  void set_engine(DrawEngine engine) {
+    draw_engine_ = engine;
+  }
+
+  const Edition<T, G>* last_edition() const {
+    return last_edit_;
+  }
+
+  size_t fund_balance() const {
+    return last_fund_balance_;
+  }
+
+  size_t jackpot_fund() const {
+    return jackpot_fund_;
+  }
+
+  // Deletes every edition but keeps the fund balance and the jackpot fund, so a script
+  // can run again without holding on to the editions of earlier runs. Edition IDs start
+  // from 0 again; ticket IDs, and with them ticket numbers, keep counting.
+  void drop_editions() {
+    if (last_edit_) {
+      for (size_t i = 0; i <= last_edit_id_; ++i)
+        delete editions_[i];
+    }
+
+    editions_ = Interlayer<Edition<T, G>*, T<Edition<T, G>*>>();
+    last_edit_ = nullptr;
+    min_ids_.clear();
+    jackpot_editions_.clear();
+    last_edit_id_ = -1;
+  }
+
+  // Frees ticket storage of the last edition once it was played
+  void release_last_tickets() {
+    if (last_edit_ && !last_edit_->is_active())
+      last_edit_->release_tickets();
+  }
+
+  void save() {
+    size_t id = sub_cmd<size_t>("Edition ID");
+    save(id, sub_cmd<std::string>("File", true));
+  }
+
+  bool save(size_t id, const std::string& path) {
+    if (!last_edit_ || id > last_edit_id_) {
+      out_ << "Edition not found" << std::endl;
+      return false;
+    }
+
+    if (editions_[id]->is_released()) {
+      out_ << "Tickets of edition " << id << " were released" << std::endl;
+      return false;
+    }
+
+    PhaseTimer timer(Phase::kSave);
+
+    if (!editions_[id]->save(path)) {
+      out_ << "Cannot write " << path << std::endl;
+      return false;
+    }
+
+    out_ << "Edition " << id << " saved to " << path << std::endl;
+
+    return true;
+  }
+
+  void load() {
+    load(sub_cmd<std::string>("File", true));
+  }
+
+  // Adds a saved edition as the newest one, renumbering its tickets to follow the
+  // existing ones; its ticket numbers do not change
+  bool load(const std::string& path) {
+    PhaseTimer timer(Phase::kLoad);
+    std::unique_ptr<MappedFile> file(new MappedFile(path));
+
+    if (!file->data()) {
+      out_ << "Cannot open " << path << std::endl;
+      return false;
+    }
+
+    if (!snapshot_header<G>(*file)) {
+      out_ << path << " is not a compatible edition snapshot" << std::endl;
+      return false;
+    }
+
+    if (last_edit_)
+      last_edit_->disable();
+
+    Edition<T, G>* edition = new Edition<T, G>(++last_edit_id_, count_, std::move(file));
+    editions_.push(edition);
+    min_ids_.push_back(count_);
+
+    if (edition->jackpot())
+      jackpot_editions_.push_back(edition->id);
+
+    last_edit_ = edition;
+    count_ += edition->count;
+
+    out_ << "Loaded edition " << edition->id << " with " << edition->count << " tickets" << std::endl;
+
+    return true;
+  }
+
+  size_t last_edition_id() const {
+    return last_edit_id_;
+  }
+
+  void engine() {
+    switch (sub_cmd<size_t>("Ball index[1], packed masks[2], completion buckets[3] or any to exit")) {
+    case 1:
+      draw_engine_ = DrawEngine::kIndex;
+      break;
+    case 2:
+      draw_engine_ = DrawEngine::kMask;
+      break;
+    case 3:
+      draw_engine_ = DrawEngine::kEvent;
+      break;
+    default:
+      return;
+    }
+
+    const char* names[] = {"ball index", "packed masks", "completion buckets"};
+
+    out_ << "Draw engine for next sales: " << names[static_cast<size_t>(draw_engine_)] << std::endl;
+  }
+
+  void stats() const {
+    Stats::print(out_);
+
+    switch (sub_cmd<size_t>("Reset[1], write trace[2], start tracing[3] or any to exit")) {
+    case 1:
+      Stats::reset();
+      break;
+    case 2: {
+      // Spans are only recorded while tracing, so the file would hold none
+      if (!Stats::is_tracing()) {
+        out_ << "Tracing is off: start it here or run with --trace" << std::endl;
+        break;
+      }
+
+      std::string path = sub_cmd<std::string>("File", true);
+
+      if (Stats::write_trace(path))
+        out_ << "Trace written to " << path << std::endl;
+      else
+        out_ << "Cannot write " << path << std::endl;
+
+      break;
+    }
+    case 3:
+      Stats::start_trace();
+
+      if (Stats::is_tracing())
+        out_ << "Tracing started" << std::endl;
+      else
+        out_ << "Statistics were compiled out (LOTTERY_STATS=0)" << std::endl;
+
+      break;
+    }
+  }
+
+  void help() const {
+    out_ << "Available commands: add, sell, play, show, search, export, engine, save, load, stats, help, exit" << std::endl;
+  }
+
+private:
+  std::ostream& out_;
+  // Output of show_* and search pages, flushed once per command or page
+  mutable OutputSink page_;
+  Interlayer<Edition<T, G>*, T<Edition<T, G>*>> editions_;
+  Edition<T, G>* last_edit_ = nullptr;
+  // First ticket ID of every edition, ascending, for binary search by ticket ID
+  std::vector<size_t> min_ids_;
+  // Editions whose jackpot was won, ascending
+  std::vector<size_t> jackpot_editions_;
+  size_t count_ = 0;
+  size_t last_edit_id_ = -1;
+  size_t last_fund_balance_ = 0;
+  size_t jackpot_fund_ = 0;
+  bool simulate_jackpot_ = false;
+  DrawEngine draw_engine_ = DrawEngine::kEvent;
+
+  // Round kinds of exports, indexed by the kind passed to for_each_round
+  static constexpr const char* kRoundKinds[] = {"row", "half", "full", "jackpot", "missed"};
+
+  // Calls func(edition, round number, kind, round) for the jackpot and the rounds of
+  // editions [first, end)
+  template <typename Func>
+  void for_each_round(size_t first, size_t end, Func func) const {
+    for (size_t i = first; i < end; ++i) {
+      if (editions_[i]->jackpot())
+        func(i, 1, 3, editions_[i]->jackpot());
+
+      for (size_t j = 0; j < editions_[i]->round_count(); ++j) {
+        const Round* round = editions_[i]->round(j);
+        func(i, j, round->missed_numbers ? 4 : G::round_kind(j), round);
+      }
+    }
+  }
+
+  void export_csv(OutputFile& file, size_t first, size_t end) const {
+    file.put("record,edition,round,kind,ticket_id,prize,balls\n");
+
+    for_each_round(first, end, [&](size_t edition, size_t number, size_t kind, const Round* round) {
+      file.put("round,");
+      file.put(uint64_t(edition));
+      file.put(',');
+      file.put(uint64_t(number));
+      file.put(',');
+      file.put(kRoundKinds[kind]);
+      file.put(",,");
+      file.put(uint64_t(round->prize));
+      file.put(',');
+
+      for (size_t i = 0; i < round->combination.size(); ++i) {
+        if (i)
+          file.put(' ');
+
+        file.put(uint64_t(round->combination[i]));
+      }
+
+      file.put('\n');
+
+      for (size_t i = 0; i < round->winners.size(); ++i) {
+        file.put("winner,");
+        file.put(uint64_t(edition));
+        file.put(',');
+        file.put(uint64_t(number));
+        file.put(',');
+        file.put(kRoundKinds[kind]);
+        file.put(',');
+        file.put(uint64_t(round->winners[i]));
+        file.put(',');
+        file.put(uint64_t(round->prize));
+        file.put(",\n");
+      }
+    });
+
+    for (size_t i = first; i < end; ++i) {
+      if (editions_[i]->is_released())
+        continue;
+
+      editions_[i]->for_each_purchased([&](size_t pos, size_t prize) {
+        file.put("ticket,");
+        file.put(uint64_t(i));
+        file.put(",,,");
+        file.put(uint64_t(editions_[i]->min_id + pos));
+        file.put(',');
+        file.put(uint64_t(prize));
+        file.put(",\n");
+      });
+    }
+  }
+
+  void export_ndjson(OutputFile& file, size_t first, size_t end) const {
+    for_each_round(first, end, [&](size_t edition, size_t number, size_t kind, const Round* round) {
+      file.put("{\"record\":\"round\",\"edition\":");
+      file.put(uint64_t(edition));
+      file.put(",\"round\":");
+      file.put(uint64_t(number));
+      file.put(",\"kind\":\"");
+      file.put(kRoundKinds[kind]);
+      file.put("\",\"prize\":");
+      file.put(uint64_t(round->prize));
+      file.put(",\"balls\":[");
+
+      for (size_t i = 0; i < round->combination.size(); ++i) {
+        if (i)
+          file.put(',');
+
+        file.put(uint64_t(round->combination[i]));
+      }
+
+      file.put("],\"winners\":[");
+
+      for (size_t i = 0; i < round->winners.size(); ++i) {
+        if (i)
+          file.put(',');
+
+        file.put(uint64_t(round->winners[i]));
+      }
+
+      file.put("]}\n");
+    });
+
+    for (size_t i = first; i < end; ++i) {
+      if (editions_[i]->is_released())
+        continue;
+
+      editions_[i]->for_each_purchased([&](size_t pos, size_t prize) {
+        file.put("{\"record\":\"ticket\",\"edition\":");
+        file.put(uint64_t(i));
+        file.put(",\"id\":");
+        file.put(uint64_t(editions_[i]->min_id + pos));
+        file.put(",\"prize\":");
+        file.put(uint64_t(prize));
+        file.put("}\n");
+      });
+    }
+  }
+
+  void export_binary(OutputFile& file, size_t first, size_t end, size_t rounds, size_t winners, size_t tickets) const {
+    ExportHeader header = {};
+    std::copy(kExportMagic, kExportMagic + 8, header.magic);
+    header.version = kExportVersion;
+    header.round_count = rounds;
+    header.winner_count = winners;
+    header.ticket_count = tickets;
+
+    file.write(&header, sizeof(header));
+
+    // One pass over the rounds per column
+    auto column = [&](auto value) {
+      for_each_round(first, end, [&](size_t edition, size_t number, size_t kind, const Round* round) {
+        auto field = value(edition, number, kind, round);
+        file.write(&field, sizeof(field));
+      });
+
+      file.align();
+    };
+
+    column([](size_t edition, size_t, size_t, const Round*) { return uint32_t(edition); });
+    column([](size_t, size_t number, size_t, const Round*) { return uint32_t(number); });
+    column([](size_t, size_t, size_t kind, const Round*) { return uint8_t(kind); });
+    column([](size_t, size_t, size_t, const Round* round) { return uint64_t(round->prize); });
+    column([](size_t, size_t, size_t, const Round* round) { return uint8_t(round->combination.size()); });
+
+    for_each_round(first, end, [&](size_t, size_t, size_t, const Round* round) {
+      uint8_t balls[kMaxBalls] = {};
+
+      for (size_t i = 0; i < round->combination.size(); ++i)
+        balls[i] = round->combination[i];
+
+      file.write(balls, sizeof(balls));
+    });
+
+    file.align();
+
+    uint64_t first_winner = 0;
+
+    for_each_round(first, end, [&](size_t, size_t, size_t, const Round* round) {
+      file.write(&first_winner, sizeof(first_winner));
+      first_winner += round->winners.size();
+    });
+
+    file.write(&first_winner, sizeof(first_winner));
+
+    for_each_round(first, end, [&](size_t, size_t, size_t, const Round* round) {
+      for (size_t i = 0; i < round->winners.size(); ++i) {
+        uint64_t id = round->winners[i];
+        file.write(&id, sizeof(id));
+      }
+    });
+
+    for (size_t column = 0; column < 2; ++column) {
+      for (size_t i = first; i < end; ++i) {
+        if (editions_[i]->is_released())
+          continue;
+
+        editions_[i]->for_each_purchased([&](size_t pos, size_t prize) {
+          uint64_t value = column ? prize : editions_[i]->min_id + pos;
+          file.write(&value, sizeof(value));
+        });
+      }
+    }
+  }
+
+  // Edition holding ticket id, or SIZE_MAX
+  size_t find_edition(size_t id) const {
+    auto it = std::upper_bound(min_ids_.begin(), min_ids_.end(), id);
+
+    if (it == min_ids_.begin())
+      return SIZE_MAX;
+
+    size_t edit_id = it - min_ids_.begin() - 1;
+
+    return id < editions_[edit_id]->min_id + editions_[edit_id]->count ? edit_id : SIZE_MAX;
+  }
+
+  bool check_sell() const {
+    if (!last_edit_) {
+      out_ << "Last edition does not exist" << std::endl;
+      return false;
+    }
+
+    if (last_edit_->is_sold()) {
+      out_ << "Last edition already sold" << std::endl;
+      return false;
+    }
+
+    return true;
+  }
+
+  template <typename Type>
+  Type sub_cmd(const char* caption, bool separate_lines = false, bool boolean = false) const {
+    Type value;
+    std::string ch;
+
+    while (true) {
+      if (!boolean) {
+        out_ << ">> " << caption << ": ";
+        std::cin >> value;
+      } else {
+        out_ << ">> " << caption << "(y/n): ";
+        std::cin >> ch;
+      }
+
+      if (!std::cin.fail()) {
+        if (boolean)
+          value = ch == "y";
+
+        break;
+      } else {
+        std::cin.clear();
+        std::cin.ignore(10000, '\n');
+      }
+    }
+
+    if (separate_lines)
+      out_ << std::endl;
+
+    return value;
+  }
+};
+
+// Mergeable summary of a stream of non-negative values: count, mean and variance
+// (Chan et al. pairwise update) plus a log-scale histogram for percentiles
+// with about 2% relative error
+class Accumulator {
+public:
+  void add(double value) {
+    if (!count_) {
+      min_ = max_ = value;
+      buckets_.assign(kBuckets, 0);
+    }
+
+    double delta = value - mean_;
+
+    ++count_;
+    mean_ += delta / count_;
+    m2_ += delta * (value - mean_);
+    min_ = std::min(min_, value);
+    max_ = std::max(max_, value);
+    ++buckets_[bucket(value)];
+  }
+
+  void merge(const Accumulator& other) {
+    if (!other.count_)
+      return;
+
+    if (!count_) {
+      *this = other;
+      return;
+    }
+
+    double total = count_ + other.count_;
+    double delta = other.mean_ - mean_;
+
+    mean_ += delta * other.count_ / total;
+    m2_ += other.m2_ + delta * delta * count_ * other.count_ / total;
+    count_ += other.count_;
+    min_ = std::min(min_, other.min_);
+    max_ = std::max(max_, other.max_);
+
+    for (size_t i = 0; i < kBuckets; ++i)
+      buckets_[i] += other.buckets_[i];
+  }
+
+  size_t count() const {
+    return count_;
+  }
+
+  double mean() const {
+    return mean_;
+  }
+
+  double variance() const {
+    return count_ > 1 ? m2_ / (count_ - 1) : 0;
+  }
+
+  double percentile(double p) const {
+    if (!count_)
+      return 0;
+
+    uint64_t rank = static_cast<uint64_t>(p / 100 * (count_ - 1));
+    size_t i = 0;
+
+    for (uint64_t seen = 0; (seen += buckets_[i]) <= rank; ++i) {}
+
+    double value = i ? std::exp2((i - 0.5) / kBucketsPerOctave) : 0;
+
+    return std::min(std::max(value, min_), max_);
+  }
+
+  void print(std::ostream& out) const {
+    out << "{\"count\":" << count_ << ",\"mean\":" << mean() << ",\"variance\":" << variance() << ",\"min\":" << (count_ ? min_ : 0)
+        << ",\"p5\":" << percentile(5) << ",\"p50\":" << percentile(50) << ",\"p95\":" << percentile(95) << ",\"p99\":" << percentile(99)
+        << ",\"max\":" << (count_ ? max_ : 0) << "}";
+  }
+
+private:
+  static const size_t kBucketsPerOctave = 16;
+  static const size_t kBuckets = 64 * kBucketsPerOctave + 1;
+
+  size_t count_ = 0;
+  double mean_ = 0;
+  double m2_ = 0;
+  double min_ = 0;
+  double max_ = 0;
+  std::vector<uint64_t> buckets_;
+
+  // Bucket 0 holds values below 1, bucket i > 0 holds [2^((i-1)/16), 2^(i/16))
+  static size_t bucket(double value) {
+    if (value < 1)
+      return 0;
+
+    return std::min<size_t>(static_cast<size_t>(std::log2(value) * kBucketsPerOctave) + 1, kBuckets - 1);
+  }
+};
+
+// Aggregates of played editions, mergeable across Monte Carlo workers
+struct PlayStats {
+  Accumulator winners;
+  Accumulator paid;
+  Accumulator balance;
+  Accumulator rounds;
+  Accumulator ruined_fund;
+  Accumulator jackpot;
+  Accumulator final_balance;
+  std::vector<Accumulator> round_winners;
+  std::vector<Accumulator> round_prize;
+
+  template <template <typename...> typename T, typename G>
+  void add(const Edition<T, G>& edit, size_t fund_balance) {
+    size_t jackpot_winners = edit.jackpot() ? edit.jackpot()->winners.size() : 0;
+
+    winners.add(edit.count_winners());
+    paid.add(edit.fund() - fund_balance + (jackpot_winners ? edit.jackpot()->prize * jackpot_winners : 0));
+    balance.add(fund_balance);
+    ruined_fund.add(edit.ruined_fund());
+    jackpot.add(jackpot_winners != 0);
+
+    size_t count = 0;
+
+    for (size_t i = 0; i < edit.round_count(); ++i) {
+      if (edit.round(i)->missed_numbers)
+        continue;
+
+      if (round_winners.size() <= count) {
+        round_winners.resize(count + 1);
+        round_prize.resize(count + 1);
+      }
+
+      round_winners[count].add(edit.round(i)->winners.size());
+      round_prize[count].add(edit.round(i)->prize);
+      ++count;
+    }
+
+    rounds.add(count);
+  }
+
+  void merge(const PlayStats& other) {
+    winners.merge(other.winners);
+    paid.merge(other.paid);
+    balance.merge(other.balance);
+    rounds.merge(other.rounds);
+    ruined_fund.merge(other.ruined_fund);
+    jackpot.merge(other.jackpot);
+    final_balance.merge(other.final_balance);
+
+    if (round_winners.size() < other.round_winners.size()) {
+      round_winners.resize(other.round_winners.size());
+      round_prize.resize(other.round_prize.size());
+    }
+
+    for (size_t i = 0; i < other.round_winners.size(); ++i) {
+      round_winners[i].merge(other.round_winners[i]);
+      round_prize[i].merge(other.round_prize[i]);
+    }
+  }
+};
+
+// Analytical counterpart of a play: per round, the distribution of the ball it ends on,
+// expected winners and payout, and the chance that the prize fund runs out, without
+// generating tickets. Given the ball order, tickets complete their rows, half cards and
+// cards independently, so no ticket completing a segment by ball k has chance
+// (1 - c(k))^n, where the per-ticket chance c(k) comes from inclusion-exclusion over
+// rows with hypergeometric terms. The fund is carried between rounds as a distribution
+// over kFundSteps steps of the initial fund. Approximations: rounds after the first card
+// round condition a ticket only on its card being incomplete, the ticket count carried
+// between rounds is its expected value given the ball the previous round ended on, and
+// very large winner counts are taken at their mean.
+class RoundModel {
+public:
+  struct RoundStats {
+    double probability = 0;     // chance that the round is drawn
+    double ball = 0;            // expected ball count at its end, given it is drawn
+    double winners = 0;         // expected winners, given it is drawn
+    double paid = 0;            // expected payout, given it is drawn
+    double ruin = 0;            // chance that the fund runs out in the round
+    std::vector<double> balls;  // balls[k - 1]: chance that it ends on ball k
+  };
+
+  RoundModel(size_t rows = Lotto90::rows, size_t cols = Lotto90::cols, size_t max_num = Lotto90::max_num, size_t half_rows = Lotto90::half_rows) : rows_(rows), cols_(cols), max_num_(max_num), half_rows_(half_rows), binom_((max_num + 1) * (max_num + 1)) {
+    size_t n = max_num_ + 1;
+
+    for (size_t i = 0; i < n; ++i) {
+      binom_[i * n] = 1;
+
+      for (size_t k = 1; k <= i; ++k)
+        binom_[i * n + k] = binom_[(i - 1) * n + k - 1] + binom_[(i - 1) * n + k];
+    }
+
+    std::vector<double> row = weights(1, 0);
+    std::vector<double> half = weights(half_rows_, 0);
+    std::vector<double> full = weights(rows_, 0);
+    std::vector<double> row_half = weights(1, half_rows_);
+    std::vector<double> half_full = weights(half_rows_, rows_);
+
+    row_.resize(n);
+    half_.resize(n);
+    full_.resize(n);
+    row_half_.resize(n * n);
+    half_full_.resize(n * n);
+
+    for (size_t k = 0; k < n; ++k) {
+      row_[k] = chance(row, k, k);
+      half_[k] = chance(half, k, k);
+      full_[k] = chance(full, k, k);
+
+      for (size_t prev = 0; prev <= k; ++prev) {
+        row_half_[prev * n + k] = chance(row_half, prev, k);
+        half_full_[prev * n + k] = chance(half_full, prev, k);
+      }
+    }
+  }
+
+  // Models a play of `sold` tickets with the given prize and jackpot funds
+  void play(size_t sold, size_t fund, size_t jackpot_fund) {
+    // The last ball is never drawn as a round, it ends the missed numbers
+    size_t last = max_num_ - 1;
+    size_t jackpot_ball = half_rows_ * cols_;
+    size_t width = kFundSteps + 1;
+    double step = std::max<double>(fund, 1) / kFundSteps;
+
+    // alive[k * width + f]: chance that the previous round ended on ball k leaving f fund
+    // steps; arrive the same for the current round before its payout, whose distribution
+    // in fund steps (the last entry for more than the whole fund) is kept in payout
+    std::vector<double> alive((last + 1) * width);
+    std::vector<double> arrive((last + 1) * width);
+    std::vector<double> payout((last + 1) * (width + 1));
+    std::vector<double> cdf(last + 1);
+    // Expected tickets still in play after the previous round ended on ball k, and the
+    // sums they are averaged from
+    std::vector<double> tickets(last + 1);
+    std::vector<double> left(last + 1);
+    std::vector<double> reach(last + 1);
+
+    rounds_.clear();
+    jackpot_rate_ = 0;
+    jackpot_winners_ = 0;
+    jackpot_paid_ = 0;
+    alive[kFundSteps] = 1;
+    tickets[0] = sold;
+
+    for (size_t number = 0;; ++number) {
+      RoundStats stats;
+      size_t prize;
+      size_t total_prize;
+
+      round_prize(number, prize, total_prize);
+      stats.balls.assign(last, 0);
+      std::fill(arrive.begin(), arrive.end(), 0);
+      std::fill(payout.begin(), payout.end(), 0);
+      std::fill(left.begin(), left.end(), 0);
+      std::fill(reach.begin(), reach.end(), 0);
+
+      for (size_t prev = 0; prev < last; ++prev) {
+        const double* funds = &alive[prev * width];
+        double mass = std::accumulate(funds, funds + width, 0.0);
+        double count = tickets[prev];
+
+        if (mass < kNegligible || count < 1 || !completion(number, prev, last, cdf))
+          continue;
+
+        // Tickets completing their half card on the jackpot ball win the jackpot instead
+        double base = 0;
+
+        if (number == 1 && prev < jackpot_ball) {
+          base = cdf[jackpot_ball];
+
+          double none = std::exp(count * std::log1p(-base));
+
+          jackpot_rate_ += mass * (1 - none);
+          jackpot_winners_ += mass * count * base;
+          jackpot_paid_ += mass * (1 - none) * jackpot_fund;
+          count -= count * base;
+        }
+
+        double survive = 1;
+
+        for (size_t k = prev + 1; k <= last && survive > kNegligible; ++k) {
+          double before = std::max(cdf[k - 1] - base, 0.0);
+          double done = std::max(cdf[k] - base, 0.0);
+          double none = std::exp(count * std::log1p(-done));
+          double p = survive - none;
+
+          survive = none;
+
+          if (p <= 0)
+            continue;
+
+          // Winners on ball k: Binomial(tickets, q) given at least one
+          double q = (done - before) / (1 - before);
+          double winners = count * q / -std::expm1(count * std::log1p(-q));
+
+          stats.probability += mass * p;
+          stats.ball += mass * p * k;
+          stats.winners += mass * p * winners;
+          stats.balls[k - 1] += mass * p;
+          left[k] += mass * p * (count - winners);
+          reach[k] += mass * p;
+
+          for (size_t f = 0; f < width; ++f)
+            arrive[k * width + f] += funds[f] * p;
+
+          add_payout(&payout[k * (width + 1)], mass * p, count, q, prize, total_prize, step);
+        }
+      }
+
+      if (stats.probability < kNegligible)
+        break;
+
+      std::fill(alive.begin(), alive.end(), 0);
+
+      // The fund runs out when the payout exceeds it, and what is left is paid instead
+      for (size_t k = 1; k <= last; ++k) {
+        double* pay = &payout[k * (width + 1)];
+        double total = std::accumulate(pay, pay + width + 1, 0.0);
+        size_t lo = 0;
+        size_t hi = width + 1;
+
+        if (total <= 0)
+          continue;
+
+        while (!pay[lo])
+          ++lo;
+
+        while (!pay[hi - 1])
+          --hi;
+
+        for (size_t f = 0; f < width; ++f) {
+          double chance = arrive[k * width + f] / total;
+
+          if (!chance)
+            continue;
+
+          for (size_t s = lo; s < hi; ++s) {
+            double m = chance * pay[s];
+
+            if (s > f) {
+              stats.ruin += m;
+              stats.paid += m * f * step;
+            } else {
+              stats.paid += m * s * step;
+              alive[k * width + f - s] += m;
+            }
+          }
+        }
+      }
+
+      stats.ball /= stats.probability;
+      stats.winners /= stats.probability;
+      stats.paid /= stats.probability;
+
+      for (size_t k = 0; k <= last; ++k)
+        tickets[k] = reach[k] > 0 ? left[k] / reach[k] : 0;
+
+      if (number == 1)
+        settle_cards(stats.balls);
+
+      rounds_.push_back(stats);
+
+      if (std::accumulate(alive.begin(), alive.end(), 0.0) < kNegligible)
+        break;
+    }
+  }
+
+  const std::vector<RoundStats>& rounds() const {
+    return rounds_;
+  }
+
+  double jackpot_rate() const {
+    return jackpot_rate_;
+  }
+
+  // Expected jackpot winners and payout over all plays
+  double jackpot_winners() const {
+    return jackpot_winners_;
+  }
+
+  double jackpot_paid() const {
+    return jackpot_paid_;
+  }
+
+private:
+  static constexpr double kNegligible = 1e-12;
+  // Resolution of the fund distribution, and the expected winner count above which a
+  // round's winners are taken at their mean
+  static const size_t kFundSteps = 256;
+  static constexpr double kExactWinners = 256;
+
+  const size_t rows_;
+  const size_t cols_;
+  const size_t max_num_;
+  const size_t half_rows_;
+  std::vector<double> binom_;
+  // Per-ticket chances: row_[k] that a row is complete by ball k, half_ and full_ the
+  // same for a half card and the card; row_half_[k0 * (max_num + 1) + k] that a row is
+  // complete by ball k0 and a half card by ball k, half_full_ the same for a half card
+  // and the card
+  std::vector<double> row_;
+  std::vector<double> half_;
+  std::vector<double> full_;
+  std::vector<double> row_half_;
+  std::vector<double> half_full_;
+  // Chance that a ticket left after the half card round has its card complete by ball k
+  std::vector<double> card_;
+  std::vector<RoundStats> rounds_;
+  double jackpot_rate_ = 0;
+  double jackpot_winners_ = 0;
+  double jackpot_paid_ = 0;
+
+  double choose(size_t n, size_t k) const {
+    return k > n ? 0 : binom_[n * (max_num_ + 1) + k];
+  }
+
+  // Inclusion-exclusion weights of the events "some inner segment is complete by ball k0"
+  // and, unless outer is 0, "some outer segment is complete by ball k", segments being
+  // runs of that many rows: entry a * (rows + 1) + b sums the signs of the non-empty
+  // segment sets whose rows number a for the inner set and b more for the outer one
+  std::vector<double> weights(size_t inner, size_t outer) const {
+    std::vector<double> result((rows_ + 1) * (rows_ + 1));
+    std::vector<uint32_t> inner_segments = segments(inner);
+    std::vector<uint32_t> outer_segments = segments(outer ? outer : rows_);
+
+    for (uint32_t i = 1; i < 1u << inner_segments.size(); ++i) {
+      uint32_t a = unite(inner_segments, i);
+      double sign = __builtin_popcount(i) % 2 ? 1 : -1;
+
+      if (!outer) {
+        result[__builtin_popcount(a) * (rows_ + 1)] += sign;
+        continue;
+      }
+
+      for (uint32_t j = 1; j < 1u << outer_segments.size(); ++j) {
+        uint32_t b = unite(outer_segments, j) & ~a;
+        result[__builtin_popcount(a) * (rows_ + 1) + __builtin_popcount(b)] += __builtin_popcount(j) % 2 ? sign : -sign;
+      }
+    }
+
+    return result;
+  }
+
+  std::vector<uint32_t> segments(size_t height) const {
+    std::vector<uint32_t> result;
+
+    for (size_t i = 0; i + height <= rows_; i += height)
+      result.push_back(((1u << height) - 1) << i);
+
+    return result;
+  }
+
+  static uint32_t unite(const std::vector<uint32_t>& segments, uint32_t set) {
+    uint32_t rows = 0;
+
+    for (size_t i = 0; i < segments.size(); ++i) {
+      if (set >> i & 1)
+        rows |= segments[i];
+    }
+
+    return rows;
+  }
+
+  // Chance of the weighted event with a rows' numbers among the first k0 balls and
+  // b more rows' numbers among the first k balls
+  double chance(const std::vector<double>& weights, size_t k0, size_t k) const {
+    double result = 0;
+
+    for (size_t a = 0; a <= rows_; ++a) {
+      for (size_t b = 0; a + b <= rows_; ++b) {
+        double weight = weights[a * (rows_ + 1) + b];
+        size_t u = a * cols_;
+        size_t v = b * cols_;
+
+        if (!weight || u > k0 || u + v > k)
+          continue;
+
+        result += weight * choose(k0, u) * choose(k - u, v) / (choose(max_num_, u) * choose(max_num_ - u, v));
+      }
+    }
+
+    return result;
+  }
+
+  // Sets card_ from the distribution of the ball ending the half card round
+  void settle_cards(const std::vector<double>& balls) {
+    size_t n = max_num_ + 1;
+    double rest = 0;
+
+    card_.assign(n, 0);
+
+    for (size_t prev = 1; prev <= balls.size(); ++prev) {
+      rest += balls[prev - 1] * (1 - half_[prev]);
+
+      for (size_t k = prev; k < n; ++k)
+        card_[k] += balls[prev - 1] * (full_[k] - half_full_[prev * n + k]);
+    }
+
+    for (size_t k = 0; k < n; ++k)
+      card_[k] /= rest;
+  }
+
+  // Fills cdf[k] for k in [prev, last] with the chance that a ticket still in play after
+  // ball prev completes the segment of round `number` by ball k
+  bool completion(size_t number, size_t prev, size_t last, std::vector<double>& cdf) const {
+    size_t n = max_num_ + 1;
+    double rest = number == 0 ? 1 : 1 - (number == 1 ? row_ : number == 2 ? half_ : card_)[prev];
+
+    if (rest <= 0)
+      return false;
+
+    for (size_t k = prev; k <= last; ++k) {
+      double done;
+
+      if (number == 0)
+        done = row_[k];
+      else if (number == 1)
+        done = half_[k] - row_half_[prev * n + k];
+      else if (number == 2)
+        done = full_[k] - half_full_[prev * n + k];
+      else
+        done = card_[k] - card_[prev];
+
+      cdf[k] = std::min(std::max(done / rest, 0.0), 1.0);
+    }
+
+    return true;
+  }
+
+  // Adds `weight` times the distribution of the round's payout in fund steps, spreading
+  // each value over the two nearest steps; Binomial(tickets, q) winners given at least
+  // one are summed exactly unless there are too many to tell from their mean
+  static void add_payout(double* payout, double weight, double tickets, double q, size_t prize, size_t total_prize, double step) {
+    double none = std::exp(tickets * std::log1p(-q));
+    double some = -std::expm1(tickets * std::log1p(-q));
+
+    if (total_prize) {
+      spread(payout, weight, total_prize / step);
+      return;
+    }
+
+    if (tickets * q > kExactWinners || q >= 1) {
+      spread(payout, weight, prize * tickets * q / some / step);
+      return;
+    }
+
+    double pmf = none;
+    double seen = 0;
+
+    for (size_t w = 1; w <= tickets && seen < some * (1 - kNegligible); ++w) {
+      pmf *= (tickets - w + 1) / w * q / (1 - q);
+      seen += pmf;
+      spread(payout, weight * pmf / some, prize * w / step);
+    }
+  }
+
+  static void spread(double* payout, double weight, double steps) {
+    if (steps >= kFundSteps + 1) {
+      payout[kFundSteps + 1] += weight;
+      return;
+    }
+
+    size_t lo = steps;
+    double frac = steps - lo;
+
+    payout[lo] += weight * (1 - frac);
+    payout[lo + 1] += weight * frac;
+  }
+};
+
+inline Progress::Progress(size_t total, const std::string& caption, bool erase) : total_(total), caption_(caption), erase_(erase), shown_(PROGRESS && total) {
+  if (!shown_)
+    return;
+
+  Reporter& reporter = Progress::reporter();
+  std::lock_guard<std::mutex> lock(reporter.mutex);
+
+  outer_ = reporter.current;
+  reporter.current = this;
+  draw();
+}
+
+inline Progress::~Progress() {
+  if (!shown_)
+    return;
+
+  Reporter& reporter = Progress::reporter();
+  std::lock_guard<std::mutex> lock(reporter.mutex);
+
+  reporter.current = outer_;
+
+  std::cout << std::string(kBarWidth + 16 + caption_.length(), ' ') << "\r";
+
+  if (!erase_)
+    std::cout << caption_ << " [" << std::string(kBarWidth, '=') << "] 100% " << std::endl;
+  else
+    std::cout.flush();
+}
+
+inline Progress::Reporter::Reporter() {
+  thread = std::thread([this]() {
+    std::unique_lock<std::mutex> lock(mutex);
+
+    while (!stop) {
+      wake.wait_for(lock, std::chrono::milliseconds(100));
+
+      if (current)
+        current->draw();
+    }
+  });
+}
+
+inline Progress::Reporter::~Reporter() {
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    stop = true;
+  }
+
+  wake.notify_all();
+  thread.join();
+}
+
+inline Progress::Reporter& Progress::reporter() {
+  static Reporter instance;
+  return instance;
+}
+
+// Called with the reporter's mutex held; skips redraws of an unchanged percentage
+inline void Progress::draw() {
+  size_t percent = std::min(done_.load(std::memory_order_relaxed), total_) * 100 / total_;
+
+  if (percent == percent_)
+    return;
+
+  percent_ = percent;
+
+  size_t pos = percent * kBarWidth / 100;
+
+  std::cout << caption_ << " [" << std::string(pos, '=') << std::string(kBarWidth - pos, ' ') << "] " << percent << "% " << '\r' << std::flush;
+}
+
+#endif
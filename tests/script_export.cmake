@@ -0,0 +1,32 @@
+# Runs a script that plays an edition and then exports it, and checks that the CSV
+# holds a ticket record for every sold ticket.
+# Usage: cmake -DLOTTERY=<lottery binary> -DWORK_DIR=<dir> -P script_export.cmake
+
+set(script "${WORK_DIR}/script_export.txt")
+set(csv "${WORK_DIR}/script_export.csv")
+
+file(REMOVE "${csv}")
+file(WRITE "${script}" "add 1000\nsell 50\nplay\nexport csv ${csv}\n")
+
+execute_process(COMMAND "${LOTTERY}" --seed 1 --script "${script}" RESULT_VARIABLE status OUTPUT_QUIET)
+
+if(NOT status EQUAL 0)
+  message(FATAL_ERROR "lottery --script failed with ${status}")
+endif()
+
+if(NOT EXISTS "${csv}")
+  message(FATAL_ERROR "export wrote no file")
+endif()
+
+file(STRINGS "${csv}" rounds REGEX "^round,")
+file(STRINGS "${csv}" tickets REGEX "^ticket,")
+list(LENGTH rounds round_count)
+list(LENGTH tickets ticket_count)
+
+if(round_count EQUAL 0)
+  message(FATAL_ERROR "export has no round records")
+endif()
+
+if(NOT ticket_count EQUAL 500)
+  message(FATAL_ERROR "export has ${ticket_count} ticket records, expected 500")
+endif()
@@ -0,0 +1,95 @@
+#include "lottery.h"
+
+#include <cstddef>
+
+// Saves a sold edition, patches its snapshot header and checks that load accepts or
+// rejects it. Exits with the number of failed checks.
+
+const std::string kSaved = "snapshot_test_saved.bin";
+const std::string kPatched = "snapshot_test_patched.bin";
+
+// Byte offsets of SnapshotHeader fields
+const size_t kPrizeCountOffset = offsetof(SnapshotHeader, prize_count);
+const size_t kVirtualOffset = offsetof(SnapshotHeader, virtual_nums);
+const size_t kEngineOffset = offsetof(SnapshotHeader, engine);
+const size_t kCountOffset = offsetof(SnapshotHeader, count);
+
+size_t failures = 0;
+
+void check(bool condition, const char* what) {
+  if (!condition) {
+    std::cerr << "FAILED: " << what << std::endl;
+    ++failures;
+  }
+}
+
+std::vector<char> read_file(const std::string& path) {
+  std::ifstream file(path, std::ios::binary);
+  return std::vector<char>(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+}
+
+void write_file(const std::string& path, const std::vector<char>& data) {
+  std::ofstream file(path, std::ios::binary);
+  file.write(data.data(), data.size());
+}
+
+template <typename Value>
+void patch(std::vector<char>& data, size_t offset, Value value) {
+  std::memcpy(&data[offset], &value, sizeof(value));
+}
+
+// True if a fresh game loads path and plays it
+bool load_and_play(const std::string& path) {
+  std::ostream null(nullptr);
+  Game<DefaultPolicy> game(null);
+
+  return game.load(path) && game.play();
+}
+
+int main() {
+  PROGRESS = false;
+
+  {
+    std::ostream null(nullptr);
+    Game<DefaultPolicy> game(null);
+
+    game.set_engine(DrawEngine::kIndex);
+    check(game.add(1000, 0, false, false, false) && game.sell(50) && game.save(0, kSaved), "save an indexed edition");
+  }
+
+  std::vector<char> saved = read_file(kSaved);
+
+  check(saved.size() >= sizeof(SnapshotHeader), "snapshot has a header");
+  check(saved[kEngineOffset] == static_cast<char>(DrawEngine::kIndex), "snapshot records the index engine");
+  check(load_and_play(kSaved), "unchanged snapshot loads and plays");
+
+  // The index engine needs stored ticket numbers
+  std::vector<char> data = saved;
+  patch<uint8_t>(data, kVirtualOffset, 1);
+  write_file(kPatched, data);
+  {
+    MappedFile file(kPatched);
+    check(!snapshot_header<Lotto90>(file), "virtual edition with the index engine is rejected");
+  }
+  check(!load_and_play(kPatched), "virtual edition with the index engine does not load");
+
+  // 32-bit postings address at most UINT32_MAX / rows tickets
+  data = saved;
+  patch<uint64_t>(data, kCountOffset, Edition<DefaultPolicy>::kMaxIndexCount + 1);
+  write_file(kPatched, data);
+  {
+    MappedFile file(kPatched);
+    check(!snapshot_header<Lotto90>(file), "index engine over kMaxIndexCount tickets is rejected");
+  }
+
+  // A wrapping prize section size
+  data = saved;
+  patch<uint64_t>(data, kPrizeCountOffset, uint64_t(1) << 60);
+  write_file(kPatched, data);
+  check(!load_and_play(kPatched), "huge prize count does not load");
+
+  std::remove(kSaved.c_str());
+  std::remove(kPatched.c_str());
+
+  return failures ? 1 : 0;
+}